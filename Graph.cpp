@@ -1,42 +1,263 @@
 #include "Graph.hpp"
-#include <iostream>
-#include <sstream>
-#include <unistd.h>
+#include "dynamic_mst.hpp"
+#include "MSTStrategy.hpp"
+#include "response.hpp"
+#include "latency_stats.hpp"
+#include <algorithm>
+
 using namespace std;
 Edge::Edge(int u, int v, double weight) : v1_(u), v2_(v), weight_(weight) {}
 
 Graph::Graph(int numVertices) : numVertices_(numVertices) {}
 
+Graph::Graph(int numVertices, shared_ptr<const Edge> edges, size_t count)
+    : numVertices_(numVertices), mappedEdges_(move(edges)), mappedCount_(count)
+{
+}
+
+Graph::Graph(const Graph &other)
+    : numVertices_(other.numVertices_), edges_(other.edges_), version_(other.version_),
+      removedEdges_(other.removedEdges_), mappedEdges_(other.mappedEdges_), mappedCount_(other.mappedCount_),
+      indexed_(other.indexed_), pairIndex_(other.pairIndex_),
+      nextSlot_(other.nextSlot_)
+{
+    {
+        lock_guard<mutex> lock(other.cacheMutex_);
+        if (other.dynamicForest_)
+        {
+            dynamicForest_ = make_unique<DynamicForest>(*other.dynamicForest_);
+        }
+    }
+    // The slots are the same, so the copy can use the adjacency until it inserts an edge
+    lock_guard<mutex> lock(other.adjacencyMutex_);
+    adjacency_ = other.adjacency_;
+}
+
+Graph::~Graph() = default;
+
+void Graph::materialize()
+{
+    if (mappedEdges_)
+    {
+        // Same slots in the same order, so the adjacency and the edge index stay valid
+        edges_.assign(mappedEdges_.get(), mappedEdges_.get() + mappedCount_);
+        mappedEdges_.reset();
+        mappedCount_ = 0;
+    }
+}
+
 void Graph::addEdge(int u, int v, double weight)
 {
+    materialize();
     edges_.emplace_back(u, v, weight);
+    ++version_;
+    adjacency_.reset();
+    if (indexed_)
+    {
+        nextSlot_.push_back(-1);
+        indexSlot(edges_.size() - 1);
+    }
+    if (dynamicForest_)
+    {
+        dynamicForest_->addEdge(u, v, weight);
+    }
 }
+
 void Graph::removeEdge(int v1, int v2)
 {
-    // Remove the edge from the list of edges
-    for (auto it = edges_.begin(); it != edges_.end(); ++it)
+    materialize();
+    if (!indexed_)
+    {
+        buildPairIndex();
+    }
+    auto it = pairIndex_.find(pairKey(v1, v2));
+    if (it == pairIndex_.end())
+    {
+        return;
+    }
+    int slot = it->second.head;
+    if (slot == it->second.tail)
+    {
+        pairIndex_.erase(it);
+    }
+    else
+    {
+        it->second.head = nextSlot_[slot];
+    }
+    // Tombstone: the slot and the adjacency entries pointing at it stay until compaction
+    edges_[slot].v1_ = edges_[slot].v2_ = -1;
+    ++removedEdges_;
+    ++version_;
+    if (dynamicForest_)
+    {
+        dynamicForest_->removeEdge(v1, v2);
+    }
+    if (removedEdges_ > numEdges())
+    {
+        compact();
+    }
+}
+
+uint64_t Graph::pairKey(int v1, int v2)
+{
+    return (uint64_t)(uint32_t)min(v1, v2) << 32 | (uint32_t)max(v1, v2);
+}
+
+void Graph::indexSlot(int slot)
+{
+    auto inserted = pairIndex_.try_emplace(pairKey(edges_[slot].v1_, edges_[slot].v2_), SlotChain{slot, slot});
+    if (!inserted.second)
+    {
+        SlotChain &chain = inserted.first->second;
+        nextSlot_[chain.tail] = slot;
+        chain.tail = slot;
+    }
+}
+
+void Graph::buildPairIndex()
+{
+    nextSlot_.assign(edges_.size(), -1);
+    pairIndex_.reserve(numEdges());
+    for (size_t slot = 0; slot < edges_.size(); ++slot)
+    {
+        if (!edges_[slot].isRemoved())
+        {
+            indexSlot(slot);
+        }
+    }
+    indexed_ = true;
+}
+
+// Runs once the removed slots outnumber the live ones, so every removal pays O(1) for it
+void Graph::compact()
+{
+    vector<int> newSlot(edges_.size(), -1);
+    int live = 0;
+    for (size_t slot = 0; slot < edges_.size(); ++slot)
+    {
+        if (!edges_[slot].isRemoved())
+        {
+            newSlot[slot] = live++;
+        }
+    }
+    // Chains only link live slots, and every slot moves to a lower or equal position
+    for (size_t slot = 0; slot < edges_.size(); ++slot)
+    {
+        if (newSlot[slot] != -1)
+        {
+            edges_[newSlot[slot]] = edges_[slot];
+            if (indexed_)
+            {
+                nextSlot_[newSlot[slot]] = nextSlot_[slot] == -1 ? -1 : newSlot[nextSlot_[slot]];
+            }
+        }
+    }
+    edges_.erase(edges_.begin() + live, edges_.end());
+    if (indexed_)
+    {
+        nextSlot_.resize(live);
+        for (auto &entry : pairIndex_)
+        {
+            entry.second.head = newSlot[entry.second.head];
+            entry.second.tail = newSlot[entry.second.tail];
+        }
+    }
+    removedEdges_ = 0;
+    adjacency_.reset();
+}
+
+shared_ptr<const CSRAdjacency> Graph::getAdjacency() const
+{
+    lock_guard<mutex> lock(adjacencyMutex_);
+    if (adjacency_)
+    {
+        return adjacency_;
+    }
+    // Two passes: count the degrees, then fill every vertex's slice of the flat arrays
+    auto adjacency = make_shared<CSRAdjacency>();
+    EdgeSpan edges = this->edges();
+    vector<int> &offset = adjacency->offset;
+    offset.assign(numVertices_ + 1, 0);
+    for (const auto &edge : edges)
     {
-        if ((it->v1_ == v1 && it->v2_ == v2) || (it->v1_ == v2 && it->v2_ == v1))
+        if (!edge.isRemoved())
         {
-            edges_.erase(it);
-            break;
+            ++offset[edge.v1_ + 1];
+            ++offset[edge.v2_ + 1];
         }
     }
+    for (int v = 0; v < numVertices_; ++v)
+    {
+        offset[v + 1] += offset[v];
+    }
+    adjacency->target.resize(offset[numVertices_]);
+    adjacency->slot.resize(offset[numVertices_]);
+    vector<int> next(offset.begin(), offset.end() - 1);
+    for (size_t slot = 0; slot < edges.size(); ++slot)
+    {
+        const Edge &edge = edges[slot];
+        if (edge.isRemoved())
+        {
+            continue;
+        }
+        adjacency->target[next[edge.v1_]] = edge.v2_;
+        adjacency->slot[next[edge.v1_]++] = slot;
+        adjacency->target[next[edge.v2_]] = edge.v1_;
+        adjacency->slot[next[edge.v2_]++] = slot;
+    }
+    adjacency_ = move(adjacency);
+    return adjacency_;
+}
+const DynamicForest &Graph::getDynamicForest() const
+{
+    if (!dynamicForest_)
+    {
+        dynamicForest_ = std::make_unique<DynamicForest>(*this);
+    }
+    return *dynamicForest_;
 }
-void Graph::printGraph(int fd)
+
+shared_ptr<const MSTree> Graph::getMST(int type, MSTStrategy &strategy, unsigned metrics) const
 {
-    for (const auto &edge : edges_)
+    // Held while computing, so concurrent readers of one version wait for a single computation
+    lock_guard<mutex> lock(cacheMutex_);
+    CachedMST &cached = mstCache_[type];
+    if (cached.tree && cached.version == version_)
     {
-        if (fd == -1)
+        cacheStats().hits++;
+        unsigned missing = metrics & ~cached.tree->getCachedMetrics();
+        if (missing != 0)
         {
-            cout << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << endl;
+            // Other readers may be using the cached tree, so the extra metrics go on a copy
+            auto upgraded = make_shared<MSTree>(*cached.tree);
+            upgraded->cacheMetrics(missing);
+            cached.tree = move(upgraded);
         }
-        else
+        return cached.tree;
+    }
+    cacheStats().misses++;
+    uint64_t start = latencyNow();
+    auto mst = make_shared<MSTree>(strategy.computeMST(*this));
+    recordLatency(PHASE_COMPUTE_MST, start);
+    mst->cacheMetrics(metrics); // Every reader of this version then gets these metrics for free
+    cached = {version_, move(mst)};
+    return cached.tree;
+}
+
+MSTCacheStats &Graph::cacheStats()
+{
+    static MSTCacheStats stats;
+    return stats;
+}
+
+void Graph::printGraph(Response &out) const
+{
+    for (const auto &edge : edges())
+    {
+        if (edge.isRemoved())
         {
-            ostringstream oss;
-            oss << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << endl;
-            string output = oss.str();
-            write(fd, output.c_str(), output.size());
+            continue;
         }
+        out << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << '\n';
     }
 }
@@ -2,22 +2,145 @@
 #define GRAPH_HPP
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
 
 struct Edge {
     int v1_, v2_;
     double weight_;
     Edge(int v1, int v2, double weight);
+    // Removed edges keep their slot, with both endpoints set to -1, until the graph is compacted
+    bool isRemoved() const
+    {
+        return v1_ < 0;
+    }
+};
+
+// Compressed sparse row adjacency of a graph: the neighbours of v are target[offset[v]] up to
+// target[offset[v + 1] - 1], and slot[i] is the index in Graph::edges() of the edge behind
+// entry i. It is built once per batch of insertions; edges removed afterwards stay in it, so
+// readers skip entries whose edge isRemoved().
+struct CSRAdjacency
+{
+    std::vector<int> offset;
+    std::vector<int> target;
+    std::vector<int> slot;
+};
+
+// Read-only view of the edge slots of a graph, wherever they are stored
+class EdgeSpan
+{
+public:
+    EdgeSpan(const Edge *data, size_t size) : data_(data), size_(size) {}
+    const Edge *begin() const { return data_; }
+    const Edge *end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    const Edge &operator[](size_t i) const { return data_[i]; }
+
+private:
+    const Edge *data_;
+    size_t size_;
+};
+
+class DynamicForest;
+class Response;
+class MSTree;
+class MSTStrategy;
+
+// Server wide hit/miss counters of the per-graph MST cache
+struct MSTCacheStats
+{
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
 };
 
 class Graph {
 public:
     int numVertices_; // Number of vertices
-    std::vector<Edge> edges_; // List of all edges in the graph
+    std::vector<Edge> edges_; // Owned edge slots, empty while the edges are read from a mapped file
 
     Graph(int vertices);
+    // Graph over `count` edges stored elsewhere, such as a mapped graph file, which the graph keeps
+    // alive. They are read in place and only copied into edges_ by the first edit.
+    Graph(int vertices, std::shared_ptr<const Edge> edges, size_t count);
+    // Copies the edges, the edge index and the dynamic forest, and shares the adjacency and any
+    // mapped edges. Not the cached trees: the copy is about to be edited.
+    Graph(const Graph &other);
+    Graph &operator=(const Graph &) = delete;
+    ~Graph();
+    // Whether v is a vertex of this graph. Endpoints must pass it before addEdge and removeEdge.
+    bool hasVertex(int v) const
+    {
+        return v >= 0 && v < numVertices_;
+    }
     void addEdge(int v1, int v2, double weight);
+    // Removes the oldest edge between v1 and v2 in O(1) amortized
     void removeEdge(int v1, int v2);
-    void printGraph(int fd);
+    // Edge slots in insertion order, removed ones included until compaction
+    EdgeSpan edges() const
+    {
+        return mappedEdges_ ? EdgeSpan(mappedEdges_.get(), mappedCount_) : EdgeSpan(edges_.data(), edges_.size());
+    }
+    // Number of edges that are not removed
+    size_t numEdges() const
+    {
+        return edges().size() - removedEdges_;
+    }
+    // Adjacency of the current edges, built on first use after an insertion. Safe to call from
+    // several threads.
+    std::shared_ptr<const CSRAdjacency> getAdjacency() const;
+    void printGraph(Response &out) const;
+    // Minimum spanning forest maintained across edge updates, built on first use
+    const DynamicForest &getDynamicForest() const;
+    // MST of this version of the graph for the given strategy type, with at least the selected
+    // MetricFlags cached, computed once and then shared by every reader. Safe to call from
+    // several threads.
+    std::shared_ptr<const MSTree> getMST(int type, MSTStrategy &strategy, unsigned metrics) const;
+    // Bumped by every addEdge and removeEdge, cached trees of older versions are never returned
+    size_t getVersion() const
+    {
+        return version_;
+    }
+    static MSTCacheStats &cacheStats();
+
+private:
+    mutable std::unique_ptr<DynamicForest> dynamicForest_;
+    size_t version_ = 0;
+    size_t removedEdges_ = 0;
+    std::shared_ptr<const Edge> mappedEdges_;
+    size_t mappedCount_ = 0;
+    // Moves mapped edges into edges_ before they get changed
+    void materialize();
+    mutable std::mutex adjacencyMutex_; // Guards the lazy build of adjacency_
+    mutable std::shared_ptr<const CSRAdjacency> adjacency_;
+
+    // Live edge slots per vertex pair (min, max), oldest first: head and tail of a chain linked
+    // through nextSlot_. Built by the first removeEdge, so loading a graph does not pay for it.
+    struct SlotChain
+    {
+        int head, tail;
+    };
+    bool indexed_ = false;
+    std::unordered_map<uint64_t, SlotChain> pairIndex_;
+    std::vector<int> nextSlot_;
+
+    static uint64_t pairKey(int v1, int v2);
+    void indexSlot(int slot);
+    void buildPairIndex();
+    // Drops the removed slots once they make up a large part of edges_
+    void compact();
+    struct CachedMST
+    {
+        size_t version;
+        std::shared_ptr<const MSTree> tree;
+    };
+    mutable std::mutex cacheMutex_; // Guards mstCache_ and the lazy build of dynamicForest_
+    mutable std::map<int, CachedMST> mstCache_; // Per strategy type
 };
 
 #endif // GRAPH_HPP
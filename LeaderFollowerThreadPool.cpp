@@ -1,7 +1,5 @@
 #include <iostream>
 #include <chrono>
-#include <unistd.h>
-#include <sstream>
 #include "LeaderFollowerThreadPool.hpp"
 using namespace std;
 // TaskGroup class implementation
@@ -15,18 +13,31 @@ void TaskGroup::waitForTaskGroup()
             { return *counter == 0; });
 }
 
+void TaskGroup::setOnComplete(function<void()> callback)
+{
+    onComplete = move(callback);
+}
+
 void TaskGroup::taskCompleted()
 {
     if (--(*counter) == 0)
     {
-        lock_guard<mutex> lock(mtx);
-        cv.notify_one();
+        function<void()> callback;
+        {
+            lock_guard<mutex> lock(mtx);
+            cv.notify_one();
+            callback.swap(onComplete); // Also drops the callback's references once it ran
+        }
+        if (callback)
+        {
+            callback();
+        }
     }
 }
 
 // LFTPTask class implementation
-LFTPTask::LFTPTask(MSTree data, int fd, shared_ptr<TaskGroup> taskGroup)
-    : taskGroup(taskGroup), data_(data), fd_(fd) {}
+LFTPTask::LFTPTask(shared_ptr<const MSTree> data, shared_ptr<TaskGroup> taskGroup)
+    : taskGroup(move(taskGroup)), data_(move(data)) {}
 
 void LFTPTask::process()
 {
@@ -34,15 +45,26 @@ void LFTPTask::process()
     taskGroup->taskCompleted(); // Notify task completion
 }
 
-// Leader-Follower Thread Pool singleton implementation
+// Index of the pool worker running on this thread, -1 for any other thread
+static thread_local int currentWorker = -1;
+
+// Thread pool singleton implementation
 LeaderFollowerThreadPool &LeaderFollowerThreadPool::getInstance(size_t numThreads)
 {
+    if (numThreads == 0)
+    {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
     static LeaderFollowerThreadPool instance(numThreads);
     return instance;
 }
 
 LeaderFollowerThreadPool::LeaderFollowerThreadPool(size_t numThreads)
 {
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        queues.push_back(make_unique<WorkerDeque>());
+    }
     // Create worker threads
     for (size_t i = 0; i < numThreads; ++i)
     {
@@ -53,10 +75,10 @@ LeaderFollowerThreadPool::LeaderFollowerThreadPool(size_t numThreads)
 LeaderFollowerThreadPool::~LeaderFollowerThreadPool()
 {
     {
-        unique_lock<mutex> lock(mtx);
+        unique_lock<mutex> lock(parkMtx);
         stopPool = true;
     }
-    condVar.notify_all();
+    parkCv.notify_all();
     for (auto &thread : threads)
     {
         if (thread.joinable())
@@ -68,125 +90,173 @@ LeaderFollowerThreadPool::~LeaderFollowerThreadPool()
 
 void LeaderFollowerThreadPool::addTaskGroup(const vector<shared_ptr<LFTPTask>> &tasks)
 {
-
-    unique_lock<mutex> lock(mtx);
     for (const auto &task : tasks)
     {
-        taskQueue.push(task);
+        // A worker submitting tasks keeps them local, everyone else spreads them round-robin
+        size_t target = currentWorker >= 0 ? currentWorker : nextQueue++ % queues.size();
+        pendingTasks++; // Counted before it becomes visible so a thief can never underflow it
+        task->enqueuedAt_ = latencyNow();
+        {
+            lock_guard<mutex> lock(queues[target]->mtx);
+            queues[target]->tasks.push_back(task);
+        }
+    }
+    {
+        lock_guard<mutex> lock(parkMtx);
+    }
+    // Wake one parked worker per task instead of the whole pool
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        parkCv.notify_one();
     }
-    condVar.notify_all(); // Notify threads that new tasks are available
 }
 
-void LeaderFollowerThreadPool::workerThread(int threadId) {
-    while (true) {
-        shared_ptr<LFTPTask> task;
-
+shared_ptr<LFTPTask> LeaderFollowerThreadPool::findTask(int threadId)
+{
+    shared_ptr<LFTPTask> task;
+    {
+        WorkerDeque &own = *queues[threadId];
+        lock_guard<mutex> lock(own.mtx);
+        if (!own.tasks.empty())
         {
-            unique_lock<mutex> lock(mtx);
-
-            // Only the first thread to enter when currentLeader == -1 will set itself as the leader
-            while (currentLeader != threadId && !stopPool) {
-                if (currentLeader == -1) {
-                    // No leader exists, so this thread becomes the leader
-                    currentLeader = threadId;
-                } else {
-                    // Wait for current leader to finish or stop signal
-                    condVar.wait(lock);
-                }
-            }
-
-            if (stopPool) {
-                break;
-            }
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues.size(); ++i)
+    {
+        WorkerDeque &victim = *queues[(threadId + i) % queues.size()];
+        lock_guard<mutex> lock(victim.mtx);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+    if (task)
+    {
+        pendingTasks--;
+    }
+    return task;
+}
 
-            // Leader waits for a task to be available in the queue
-            condVar.wait(lock, [this] { return !taskQueue.empty() || stopPool; });
+void LeaderFollowerThreadPool::workerThread(int threadId) {
+    currentWorker = threadId;
+    while (true) {
+        shared_ptr<LFTPTask> task = findTask(threadId);
 
+        if (!task) {
+            // Nothing to run or steal: park until a task is published or the pool stops
+            unique_lock<mutex> lock(parkMtx);
+            parkCv.wait(lock, [this] { return pendingTasks > 0 || stopPool; });
             if (stopPool) {
                 break;
             }
-
-            // As the leader, pick the next task if available
-            if (!taskQueue.empty()) {
-                task = taskQueue.front();
-                taskQueue.pop();
-            }
-
-            // Pass leadership if there are other threads waiting
-            currentLeader = -1;
-            condVar.notify_all();  // Notify waiting threads to check for leadership
+            continue;
         }
 
-        // Process the task outside the critical section
-        if (task) {
-            task->process();  // Process with current thread's ID
-        }
+        // Process the task outside of any lock
+        recordLatency(PHASE_POOL_QUEUE_WAIT, task->enqueuedAt_);
+        task->process();
     }
 }
 
 class LFTPTotalWeight : public LFTPTask
 {
 public:
-    LFTPTotalWeight(MSTree data, int fd, shared_ptr<TaskGroup> taskGroup) : LFTPTask(data, fd, taskGroup) {}
+    LFTPTotalWeight(shared_ptr<const MSTree> data, shared_ptr<TaskGroup> taskGroup) : LFTPTask(move(data), move(taskGroup)) {}
     void execute()
     {
-        ostringstream oss;
-        oss << "TotalWeight: " << data_.getTotalWeight() << endl;
-        string output = oss.str();
-        write(fd_, output.c_str(), output.size());
+        LatencyTimer timer(PHASE_LFTP_TOTAL_WEIGHT);
+        result_ << "TotalWeight: " << data_->getTotalWeight() << '\n';
     }
 };
 
 class LFTPLongestDistance : public LFTPTask
 {
 public:
-    LFTPLongestDistance(MSTree data, int fd, shared_ptr<TaskGroup> taskGroup) : LFTPTask(data, fd, taskGroup) {}
+    LFTPLongestDistance(shared_ptr<const MSTree> data, shared_ptr<TaskGroup> taskGroup) : LFTPTask(move(data), move(taskGroup)) {}
     void execute()
     {
-        ostringstream oss;
-        oss << "LongestDistance: " << data_.findLongestDistance() << endl;
-        string output = oss.str();
-        write(fd_, output.c_str(), output.size());
+        LatencyTimer timer(PHASE_LFTP_LONGEST_DISTANCE);
+        result_ << "LongestDistance: " << data_->findLongestDistance() << '\n';
     }
 };
 
 class LFTPAverageDistance : public LFTPTask
 {
 public:
-    LFTPAverageDistance(MSTree data, int fd, shared_ptr<TaskGroup> taskGroup) : LFTPTask(data, fd, taskGroup) {}
+    LFTPAverageDistance(shared_ptr<const MSTree> data, shared_ptr<TaskGroup> taskGroup) : LFTPTask(move(data), move(taskGroup)) {}
     void execute()
     {
-        ostringstream oss;
-        oss << "AverageDistance: " << data_.findAverageDistance() << endl;
-        string output = oss.str();
-        write(fd_, output.c_str(), output.size());
+        LatencyTimer timer(PHASE_LFTP_AVERAGE_DISTANCE);
+        result_ << "AverageDistance: " << data_->findAverageDistance() << '\n';
     }
 };
 
 class LFTPShortestDistance : public LFTPTask
 {
 public:
-    LFTPShortestDistance(MSTree data, int fd, shared_ptr<TaskGroup> taskGroup) : LFTPTask(data, fd, taskGroup) {}
+    LFTPShortestDistance(shared_ptr<const MSTree> data, shared_ptr<TaskGroup> taskGroup) : LFTPTask(move(data), move(taskGroup)) {}
+    void execute()
+    {
+        LatencyTimer timer(PHASE_LFTP_SHORTEST_DISTANCE);
+        result_ << "ShortestDistance: " << data_->findShortestDistance() << '\n';
+    }
+};
+
+class LFTPJob : public LFTPTask
+{
+public:
+    LFTPJob(function<void()> job, shared_ptr<TaskGroup> taskGroup) : LFTPTask(nullptr, move(taskGroup)), job_(move(job)) {}
     void execute()
     {
-        ostringstream oss;
-        oss << "ShortestDistance: " << data_.findShortestDistance() << endl;
-        string output = oss.str();
-        write(fd_, output.c_str(), output.size());
+        LatencyTimer timer(PHASE_LFTP_JOB);
+        job_();
     }
+
+private:
+    function<void()> job_;
 };
 
-void executeLeaderFollowerThreadPool(MSTree data, int fd)
+void submitToLeaderFollowerThreadPool(function<void()> job)
+{
+    auto taskGroup = make_shared<TaskGroup>(1);
+    LeaderFollowerThreadPool::getInstance().addTaskGroup({make_shared<LFTPJob>(move(job), taskGroup)});
+}
+
+void executeLeaderFollowerThreadPool(shared_ptr<const MSTree> data, shared_ptr<Response> output,
+                                     unsigned metrics, function<void()> done)
 {
-    LeaderFollowerThreadPool &pool = LeaderFollowerThreadPool::getInstance(4);
+    LeaderFollowerThreadPool &pool = LeaderFollowerThreadPool::getInstance();
     vector<shared_ptr<LFTPTask>> tasks;
-    auto taskGroup = make_shared<TaskGroup>(4);
-    tasks.push_back(make_shared<LFTPTotalWeight>(data, fd, taskGroup));
-    tasks.push_back(make_shared<LFTPLongestDistance>(data, fd, taskGroup));
-    tasks.push_back(make_shared<LFTPAverageDistance>(data, fd, taskGroup));
-    tasks.push_back(make_shared<LFTPShortestDistance>(data, fd, taskGroup));
+    size_t taskCount = 0;
+    for (unsigned metric = 1; metric & METRIC_ALL; metric <<= 1)
+    {
+        taskCount += (metrics & metric) != 0;
+    }
+    if (taskCount == 0)
+    {
+        done();
+        return;
+    }
+    auto taskGroup = make_shared<TaskGroup>(taskCount);
+    if (metrics & METRIC_TOTAL_WEIGHT)
+        tasks.push_back(make_shared<LFTPTotalWeight>(data, taskGroup));
+    if (metrics & METRIC_LONGEST_DISTANCE)
+        tasks.push_back(make_shared<LFTPLongestDistance>(data, taskGroup));
+    if (metrics & METRIC_AVERAGE_DISTANCE)
+        tasks.push_back(make_shared<LFTPAverageDistance>(data, taskGroup));
+    if (metrics & METRIC_SHORTEST_DISTANCE)
+        tasks.push_back(make_shared<LFTPShortestDistance>(data, taskGroup));
+    // Gather the results once the last task is done, nobody waits for the group
+    taskGroup->setOnComplete([tasks, output, done]()
+                             {
+        for (const auto &task : tasks)
+        {
+            *output << task->getResult();
+        }
+        done(); });
     // Add the task group to the pool
     pool.addTaskGroup(tasks);
-    // Wait for all tasks in the group to complete
-    taskGroup->waitForTaskGroup();
-}
\ No newline at end of file
+}
@@ -5,10 +5,13 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <atomic>
+#include <functional>
 #include "MSTree.hpp"
+#include "response.hpp"
+#include "latency_stats.hpp"
 
 // Class to encapsulate task group state
 class TaskGroup
@@ -18,8 +21,12 @@ private:
     std::shared_ptr<std::atomic<int>> counter; // Shared counter for task group
     std::condition_variable cv;                // Condition variable for notification
     std::mutex mtx;                            // Mutex for condition variable
+    std::function<void()> onComplete;          // Run by the worker finishing the last task
 public:
     TaskGroup(size_t taskCount);
+    // Called once all tasks are done, on the worker that finished the last one.
+    // Must be set before the tasks are added to the pool.
+    void setOnComplete(std::function<void()> callback);
     // Method to wait until all tasks in the group are complete
     void waitForTaskGroup();
     // Method to notify that a task has completed
@@ -31,16 +38,29 @@ class LFTPTask
 private:
     std::shared_ptr<TaskGroup> taskGroup; // Shared task group instance
 protected:
-    MSTree data_; // Unique task ID
-    int fd_;
+    std::shared_ptr<const MSTree> data_; // Immutable snapshot shared by all tasks of a group
+    Response result_;                    // Output of the task, gathered once the group is done
 
 public:
-    LFTPTask(MSTree data, int fd, std::shared_ptr<TaskGroup> taskGroup);
+    uint64_t enqueuedAt_ = 0; // latencyNow() when the task was added to the pool
+    LFTPTask(std::shared_ptr<const MSTree> data, std::shared_ptr<TaskGroup> taskGroup);
     void process();
     virtual void execute() = 0;
+    const Response &getResult() const
+    {
+        return result_;
+    }
 };
 
-// Leader-Follower Thread Pool Singleton class
+// Per-worker task deque. The owner pushes and pops at the back, thieves take from the front.
+struct WorkerDeque
+{
+    std::deque<std::shared_ptr<LFTPTask>> tasks;
+    std::mutex mtx;
+};
+
+// Thread pool singleton class. Historically a leader/follower pool; tasks are now spread over
+// per-worker deques, idle workers steal from their peers and park when there is no work at all.
 class LeaderFollowerThreadPool
 {
 
@@ -50,16 +70,19 @@ private:
     ~LeaderFollowerThreadPool();
 
     void workerThread(int threadId);
+    // Pop from the worker's own deque, otherwise steal from another worker
+    std::shared_ptr<LFTPTask> findTask(int threadId);
     std::vector<std::thread> threads;
-    std::queue<std::shared_ptr<LFTPTask>> taskQueue;
-    std::mutex mtx;
-    std::condition_variable condVar;
+    std::vector<std::unique_ptr<WorkerDeque>> queues;
+    std::atomic<size_t> nextQueue{0};   // Round-robin target for tasks submitted from outside the pool
+    std::atomic<size_t> pendingTasks{0}; // Tasks queued but not yet taken by a worker
+    std::mutex parkMtx;                 // Protects parking only, never held while running a task
+    std::condition_variable parkCv;
     bool stopPool = false;
-    int currentLeader = -1;
 
 public:
-    // Method to access the singleton instance
-    static LeaderFollowerThreadPool &getInstance(size_t numThreads = 4);
+    // Method to access the singleton instance (0 threads means std::thread::hardware_concurrency())
+    static LeaderFollowerThreadPool &getInstance(size_t numThreads = 0);
 
     // Prevent copying and assignment
     LeaderFollowerThreadPool(const LeaderFollowerThreadPool &) = delete;
@@ -68,6 +91,12 @@ public:
     void addTaskGroup(const std::vector<std::shared_ptr<LFTPTask>> &tasks);
 };
 
-void executeLeaderFollowerThreadPool(MSTree data, int fd);
+// Run job on a pool worker without waiting for it
+void submitToLeaderFollowerThreadPool(std::function<void()> job);
+
+// Run one pool task per selected metric (MetricFlags) without waiting for them. Once all are done,
+// their results are appended to output in a fixed order and done is called on a pool worker.
+void executeLeaderFollowerThreadPool(std::shared_ptr<const MSTree> data, std::shared_ptr<Response> output,
+                                     unsigned metrics, std::function<void()> done);
 
 #endif // LEADERFOLLOWERTHREADPOOL_HPP
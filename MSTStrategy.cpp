@@ -1,4 +1,11 @@
 #include "MSTStrategy.hpp"
+#include "dynamic_mst.hpp"
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
 
 
 using namespace std;
@@ -7,14 +14,8 @@ MSTree PrimMST::computeMST(const Graph &graph)
 {
 
     int n = graph.numVertices_;                // Number of vertices
-    vector<vector<PrimEdge>> adj(n); // Adjacency list
-
-    // Convert the edges from the Graph object to an adjacency list
-    for (const auto &edge : graph.edges_)
-    {
-        adj[edge.v1_].push_back(PrimEdge(edge.weight_, edge.v2_, edge.v1_));
-        adj[edge.v2_].push_back(PrimEdge(edge.weight_, edge.v1_, edge.v2_)); // Because the graph is undirected
-    }
+    auto adj = graph.getAdjacency();          // Shared adjacency of the graph, both directions of every edge
+    EdgeSpan edges = graph.edges();
 
     
     MSTree mst(graph.numVertices_);  // Make sure the number of vertices is correct
@@ -40,8 +41,12 @@ MSTree PrimMST::computeMST(const Graph &graph)
         }
 
         // Explore the adjacent vertices
-        for (const PrimEdge &e : adj[v])
+        for (int i = adj->offset[v]; i < adj->offset[v + 1]; ++i)
         {
+            const Edge &edge = edges[adj->slot[i]];
+            if (edge.isRemoved())
+                continue;
+            PrimEdge e(edge.weight_, adj->target[i], v);
             if (!selected[e.to] && e.w < min_e[e.to].w)
             {
                 q.erase({min_e[e.to].w, e.to, min_e[e.to].id});
@@ -54,13 +59,147 @@ MSTree PrimMST::computeMST(const Graph &graph)
     return mst; // Return the MST result
 }
 
+// Min-heap of vertices keyed by weight, 4 children per node. pos_ tracks where every vertex
+// sits in the heap so that its key can be lowered without searching for it.
+class IndexedHeap
+{
+public:
+    explicit IndexedHeap(int n) : pos_(n, -1), key_(n) {}
+    bool empty() const { return heap_.empty(); }
+    bool contains(int v) const { return pos_[v] != -1; }
+    double key(int v) const { return key_[v]; }
+
+    // Insert v with the given key, or lower its key if it is already in the heap
+    void push(int v, double key)
+    {
+        key_[v] = key;
+        if (pos_[v] == -1)
+        {
+            pos_[v] = heap_.size();
+            heap_.push_back(v);
+        }
+        siftUp(pos_[v]);
+    }
+
+    int pop()
+    {
+        int top = heap_[0];
+        pos_[top] = -1;
+        int last = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty())
+        {
+            heap_[0] = last;
+            pos_[last] = 0;
+            siftDown(0);
+        }
+        return top;
+    }
+
+private:
+    static constexpr size_t ARITY = 4;
+    vector<int> heap_;
+    vector<int> pos_;
+    vector<double> key_;
+
+    void place(size_t i, int v)
+    {
+        heap_[i] = v;
+        pos_[v] = i;
+    }
+    void siftUp(size_t i)
+    {
+        int v = heap_[i];
+        while (i > 0)
+        {
+            size_t parent = (i - 1) / ARITY;
+            if (key_[heap_[parent]] <= key_[v])
+                break;
+            place(i, heap_[parent]);
+            i = parent;
+        }
+        place(i, v);
+    }
+    void siftDown(size_t i)
+    {
+        int v = heap_[i];
+        while (true)
+        {
+            size_t first = i * ARITY + 1;
+            if (first >= heap_.size())
+                break;
+            size_t best = first;
+            for (size_t c = first + 1; c < min(first + ARITY, heap_.size()); ++c)
+            {
+                if (key_[heap_[c]] < key_[heap_[best]])
+                    best = c;
+            }
+            if (key_[v] <= key_[heap_[best]])
+                break;
+            place(i, heap_[best]);
+            i = best;
+        }
+        place(i, v);
+    }
+};
+
+// Implement Prim's MST Algorithm with an indexed heap over the graph's CSR adjacency
+MSTree HeapPrimMST::computeMST(const Graph &graph)
+{
+    int n = graph.numVertices_;
+    EdgeSpan edges = graph.edges();
+    auto adj = graph.getAdjacency();
+    const vector<int> &offset = adj->offset;
+    const vector<int> &target = adj->target;
+
+    MSTree mst(n);
+    IndexedHeap heap(n);
+    vector<int> parent(n, -1);
+    vector<bool> selected(n, false);
+    for (int root = 0; root < n; ++root)
+    {
+        if (selected[root])
+            continue;
+        heap.push(root, 0);
+        while (!heap.empty())
+        {
+            int v = heap.pop();
+            selected[v] = true;
+            if (parent[v] != -1)
+            {
+                mst.addEdge({parent[v], v, heap.key(v)});
+            }
+            for (int i = offset[v]; i < offset[v + 1]; ++i)
+            {
+                int u = target[i];
+                if (selected[u])
+                    continue;
+                const Edge &edge = edges[adj->slot[i]];
+                if (!edge.isRemoved() && (!heap.contains(u) || edge.weight_ < heap.key(u)))
+                {
+                    parent[u] = v;
+                    heap.push(u, edge.weight_);
+                }
+            }
+        }
+    }
+
+    return mst;
+}
+
 // Implement Kruskal's MST Algorithm
 MSTree KruskalMST::computeMST(const Graph &graph)
 {
     // Kruskal's algorithm logic here
 
     UnionFind uf(graph.numVertices_);  // Union-Find initialized with number of vertices
-    vector<Edge> edges = graph.edges_; // Get all edges from the graph
+    vector<Edge> edges;                // Get all live edges from the graph
+    edges.reserve(graph.numEdges());
+    for (const auto &edge : graph.edges())
+    {
+        if (!edge.isRemoved())
+            edges.push_back(edge);
+    }
      MSTree mst(graph.numVertices_);        // To store the resulting MST
 
     // Sort edges by weight (cost) in ascending order
@@ -84,6 +223,394 @@ MSTree KruskalMST::computeMST(const Graph &graph)
     return mst; // Return the resulting MST
 }
 
+// Unsigned key that sorts like the double: flip every bit of a negative, only the sign bit otherwise
+static uint64_t weightKey(double weight)
+{
+    uint64_t bits;
+    memcpy(&bits, &weight, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+// LSD radix sort of [first, last) by weight, one byte of the key per pass. All eight histograms
+// come out of a single pass, and bytes that are the same in every key are skipped.
+static void radixSortByWeight(Edge *first, Edge *last, vector<Edge> &scratch)
+{
+    size_t n = last - first;
+    if (n < 2)
+        return;
+    if (scratch.size() < n)
+        scratch.resize(n, Edge(0, 0, 0));
+    vector<size_t> count(8 * 256, 0);
+    for (Edge *e = first; e != last; ++e)
+    {
+        uint64_t key = weightKey(e->weight_);
+        for (int b = 0; b < 8; ++b)
+            ++count[b * 256 + ((key >> (8 * b)) & 0xff)];
+    }
+    uint64_t firstKey = weightKey(first->weight_);
+    Edge *from = first, *to = scratch.data();
+    for (int b = 0; b < 8; ++b)
+    {
+        size_t *bucket = &count[b * 256];
+        if (bucket[(firstKey >> (8 * b)) & 0xff] == n)
+            continue;
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d)
+        {
+            size_t size = bucket[d];
+            bucket[d] = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            to[bucket[(weightKey(from[i].weight_) >> (8 * b)) & 0xff]++] = from[i];
+        }
+        swap(from, to);
+    }
+    if (from != first)
+        copy(from, from + n, first);
+}
+
+struct FilterKruskalState
+{
+    UnionFind uf;
+    MSTree mst;
+    size_t threshold; // Largest partition that is sorted instead of split
+    vector<Edge> scratch;
+};
+
+static void filterKruskal(Edge *first, Edge *last, FilterKruskalState &state)
+{
+    if (state.uf.cc == 1)
+        return; // Already spanning, every remaining edge closes a cycle
+    size_t n = last - first;
+    Edge *mid = first;
+    if (n > state.threshold)
+    {
+        // Median of evenly spaced samples as the pivot
+        vector<double> sample;
+        for (size_t i = 0; i < 31; ++i)
+            sample.push_back(first[i * (n - 1) / 30].weight_);
+        nth_element(sample.begin(), sample.begin() + 15, sample.end());
+        double pivot = sample[15];
+        mid = partition(first, last, [pivot](const Edge &e)
+                        { return e.weight_ <= pivot; });
+    }
+    if (mid == first || mid == last)
+    {
+        // Small enough, or too many equal weights to split: plain Kruskal on the sorted range
+        radixSortByWeight(first, last, state.scratch);
+        for (Edge *e = first; e != last; ++e)
+        {
+            if (state.uf.unite(e->v1_, e->v2_))
+                state.mst.addEdge(*e);
+        }
+        return;
+    }
+    filterKruskal(first, mid, state);
+    // Heavy edges whose endpoints the light ones already connect can never join the tree
+    Edge *kept = partition(mid, last, [&state](const Edge &e)
+                           { return state.uf.find_parent(e.v1_) != state.uf.find_parent(e.v2_); });
+    filterKruskal(mid, kept, state);
+}
+
+MSTree FilterKruskalMST::computeMST(const Graph &graph)
+{
+    vector<Edge> edges;
+    edges.reserve(graph.numEdges());
+    for (const auto &edge : graph.edges())
+    {
+        if (!edge.isRemoved())
+            edges.push_back(edge);
+    }
+    FilterKruskalState state{UnionFind(graph.numVertices_), MSTree(graph.numVertices_),
+                             max<size_t>(graph.numVertices_, 1024), {}};
+    filterKruskal(edges.data(), edges.data() + edges.size(), state);
+    return state.mst;
+}
+
+// Split [0, count) into one contiguous chunk per thread and run body(begin, end, threadIndex)
+static void parallelFor(size_t numThreads, size_t count, const function<void(size_t, size_t, size_t)> &body)
+{
+    size_t chunk = (count + numThreads - 1) / numThreads;
+    vector<thread> threads;
+    for (size_t t = 1; t < numThreads && t * chunk < count; ++t)
+    {
+        threads.emplace_back(body, t * chunk, min(count, (t + 1) * chunk), t);
+    }
+    body(0, min(count, chunk), 0); // The calling thread takes the first chunk
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+}
+
+BoruvkaMST::BoruvkaMST(size_t numThreads) : numThreads_(numThreads)
+{
+    if (numThreads_ == 0)
+    {
+        numThreads_ = max(1u, thread::hardware_concurrency());
+    }
+}
+
+// Implement Boruvka's MST Algorithm
+MSTree BoruvkaMST::computeMST(const Graph &graph)
+{
+    int n = graph.numVertices_;
+    EdgeSpan edges = graph.edges();
+    ConcurrentUnionFind uf(n);
+    MSTree mst(n);
+    vector<int> component(n);
+    vector<atomic<int>> cheapest(n);
+    vector<vector<int>> picked(numThreads_); // MST edge ids found by each thread in a round
+
+    // Strict order on edges (weight, then id) so that all components agree and no cycle is picked
+    auto lighter = [&edges](int a, int b)
+    {
+        return edges[a].weight_ < edges[b].weight_ || (edges[a].weight_ == edges[b].weight_ && a < b);
+    };
+
+    bool merged = true;
+    while (merged)
+    {
+        // Snapshot the component of every vertex and reset the cheapest edge of each component
+        parallelFor(numThreads_, n, [&](size_t begin, size_t end, size_t)
+                    {
+            for (size_t v = begin; v < end; ++v)
+            {
+                component[v] = uf.find_parent(v);
+                cheapest[v].store(-1, memory_order_relaxed);
+            } });
+
+        // Find the cheapest outgoing edge of every component
+        parallelFor(numThreads_, edges.size(), [&](size_t begin, size_t end, size_t)
+                    {
+            for (size_t e = begin; e < end; ++e)
+            {
+                if (edges[e].isRemoved())
+                    continue;
+                int c1 = component[edges[e].v1_], c2 = component[edges[e].v2_];
+                if (c1 == c2)
+                    continue;
+                for (int c : {c1, c2})
+                {
+                    int current = cheapest[c].load(memory_order_relaxed);
+                    while ((current == -1 || lighter(e, current)) &&
+                           !cheapest[c].compare_exchange_weak(current, e, memory_order_relaxed))
+                    {
+                    }
+                }
+            } });
+
+        // Contract every component along its cheapest edge
+        parallelFor(numThreads_, n, [&](size_t begin, size_t end, size_t t)
+                    {
+            for (size_t c = begin; c < end; ++c)
+            {
+                int e = cheapest[c].load(memory_order_relaxed);
+                if (e != -1 && uf.unite(edges[e].v1_, edges[e].v2_))
+                {
+                    picked[t].push_back(e);
+                }
+            } });
+
+        merged = false;
+        for (auto &ids : picked)
+        {
+            for (int e : ids)
+            {
+                mst.addEdge(edges[e]);
+            }
+            merged = merged || !ids.empty();
+            ids.clear();
+        }
+    }
+
+    return mst;
+}
+
+ParallelKruskalMST::ParallelKruskalMST(size_t numThreads) : numThreads_(numThreads)
+{
+    if (numThreads_ == 0)
+    {
+        numThreads_ = max(1u, thread::hardware_concurrency());
+    }
+}
+
+static uint64_t edgePairKey(const Edge &edge)
+{
+    return (uint64_t)(uint32_t)min(edge.v1_, edge.v2_) << 32 | (uint32_t)max(edge.v1_, edge.v2_);
+}
+
+// Appends to out the lightest edge of every vertex pair found in the parts, using an
+// open-addressing table from pair key to position in out
+static void keepLightestPerPair(const vector<vector<Edge>> &parts, vector<Edge> &out)
+{
+    size_t count = 0;
+    for (const auto &part : parts)
+        count += part.size();
+    int bits = 4;
+    while ((size_t(1) << bits) < 2 * count)
+        ++bits;
+    size_t capacity = size_t(1) << bits;
+    const uint64_t EMPTY = ~0ULL; // Never a key: both halves of a key are non-negative ints
+    vector<uint64_t> keys(capacity, EMPTY);
+    vector<int> position(capacity);
+    out.reserve(count);
+    for (const auto &part : parts)
+    {
+        for (const Edge &edge : part)
+        {
+            uint64_t key = edgePairKey(edge);
+            // A different multiplier than the owner hash, whose bits are the same for the whole table
+            size_t i = (key * 0xC2B2AE3D27D4EB4FULL) >> (64 - bits);
+            while (keys[i] != EMPTY && keys[i] != key)
+                i = (i + 1) & (capacity - 1);
+            if (keys[i] == EMPTY)
+            {
+                keys[i] = key;
+                position[i] = out.size();
+                out.push_back(edge);
+            }
+            else if (edge.weight_ < out[position[i]].weight_)
+            {
+                out[position[i]] = edge;
+            }
+        }
+    }
+}
+
+MSTree ParallelKruskalMST::computeMST(const Graph &graph)
+{
+    size_t threads = numThreads_;
+    EdgeSpan edges = graph.edges();
+
+    // Drop removed slots and self-loops, and hand every edge to the thread owning its vertex pair
+    vector<vector<vector<Edge>>> byOwner(threads, vector<vector<Edge>>(threads));
+    parallelFor(threads, edges.size(), [&](size_t begin, size_t end, size_t t)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const Edge &edge = edges[i];
+            if (edge.isRemoved() || edge.v1_ == edge.v2_)
+                continue;
+            byOwner[t][(edgePairKey(edge) * 0x9E3779B97F4A7C15ULL >> 32) % threads].push_back(edge);
+        } });
+
+    // Every owner sees all the parallel edges of its pairs and keeps the lightest one
+    vector<vector<Edge>> owned(threads);
+    parallelFor(threads, threads, [&](size_t begin, size_t end, size_t)
+                {
+        for (size_t owner = begin; owner < end; ++owner)
+        {
+            vector<vector<Edge>> parts;
+            for (auto &local : byOwner)
+                parts.push_back(move(local[owner]));
+            keepLightestPerPair(parts, owned[owner]);
+        } });
+    byOwner.clear();
+
+    // Splitters from a regular sample cut the weights into ranges, a few per thread so that the
+    // union-find can start on the first range long before the last one is sorted
+    size_t total = 0;
+    for (const auto &part : owned)
+        total += part.size();
+    size_t buckets = total < 65536 ? 1 : 4 * threads;
+    vector<double> sample;
+    for (const auto &part : owned)
+    {
+        for (size_t i = 0; i < 16 * buckets && !part.empty(); ++i)
+            sample.push_back(part[i * (part.size() - 1) / max<size_t>(1, 16 * buckets - 1)].weight_);
+    }
+    sort(sample.begin(), sample.end());
+    vector<double> splitters;
+    for (size_t b = 1; b < buckets; ++b)
+        splitters.push_back(sample[b * sample.size() / buckets]);
+    auto bucketOf = [&splitters](double weight)
+    {
+        return upper_bound(splitters.begin(), splitters.end(), weight) - splitters.begin();
+    };
+
+    // Count, then scatter every owner's edges into its slice of each range
+    vector<vector<size_t>> count(threads, vector<size_t>(buckets, 0));
+    parallelFor(threads, threads, [&](size_t begin, size_t end, size_t)
+                {
+        for (size_t owner = begin; owner < end; ++owner)
+            for (const Edge &edge : owned[owner])
+                ++count[owner][bucketOf(edge.weight_)]; });
+    vector<size_t> bucketStart(buckets + 1, 0);
+    vector<vector<size_t>> next(threads, vector<size_t>(buckets));
+    for (size_t b = 0; b < buckets; ++b)
+    {
+        size_t offset = bucketStart[b];
+        for (size_t owner = 0; owner < threads; ++owner)
+        {
+            next[owner][b] = offset;
+            offset += count[owner][b];
+        }
+        bucketStart[b + 1] = offset;
+    }
+    vector<Edge> sorted(total, Edge(0, 0, 0));
+    parallelFor(threads, threads, [&](size_t begin, size_t end, size_t)
+                {
+        for (size_t owner = begin; owner < end; ++owner)
+        {
+            for (const Edge &edge : owned[owner])
+                sorted[next[owner][bucketOf(edge.weight_)]++] = edge;
+            vector<Edge>().swap(owned[owner]);
+        } });
+
+    // Sorters take the ranges lightest first; the union-find follows right behind them
+    vector<bool> ready(buckets, false);
+    mutex readyMutex;
+    condition_variable readyCv;
+    atomic<size_t> nextBucket{0};
+    atomic<bool> spanning{false};
+    vector<thread> sorters;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        sorters.emplace_back([&]()
+                             {
+            vector<Edge> scratch;
+            size_t b;
+            while (!spanning.load(memory_order_relaxed) && (b = nextBucket++) < buckets)
+            {
+                radixSortByWeight(sorted.data() + bucketStart[b], sorted.data() + bucketStart[b + 1], scratch);
+                {
+                    lock_guard<mutex> lock(readyMutex);
+                    ready[b] = true;
+                }
+                readyCv.notify_all();
+            } });
+    }
+
+    UnionFind uf(graph.numVertices_);
+    MSTree mst(graph.numVertices_);
+    for (size_t b = 0; b < buckets && uf.cc > 1; ++b)
+    {
+        {
+            unique_lock<mutex> lock(readyMutex);
+            readyCv.wait(lock, [&]()
+                         { return ready[b]; });
+        }
+        for (size_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i)
+        {
+            if (uf.unite(sorted[i].v1_, sorted[i].v2_))
+                mst.addEdge(sorted[i]);
+        }
+    }
+    spanning = true; // Ranges nobody has started on are not needed any more
+    for (auto &sorter : sorters)
+        sorter.join();
+    return mst;
+}
+
+// The first call builds the forest in O(E log V), later calls only copy out the tree edges
+MSTree DynamicMST::computeMST(const Graph &graph)
+{
+    return graph.getDynamicForest().getTree();
+}
+
 // Factory method to create the correct MST strategy based on the type
 unique_ptr<MSTStrategy> MSTFactory::getMSTStrategy(MSTType type)
 {
@@ -91,8 +618,18 @@ unique_ptr<MSTStrategy> MSTFactory::getMSTStrategy(MSTType type)
     {
     case PRIM:
         return make_unique<PrimMST>();
+    case PRIM_HEAP:
+        return make_unique<HeapPrimMST>();
     case KRUSKAL:
         return make_unique<KruskalMST>();
+    case FILTER_KRUSKAL:
+        return make_unique<FilterKruskalMST>();
+    case PARALLEL_KRUSKAL:
+        return make_unique<ParallelKruskalMST>();
+    case BORUVKA:
+        return make_unique<BoruvkaMST>();
+    case DYNAMIC:
+        return make_unique<DynamicMST>();
     default:
         return nullptr;
     }
@@ -37,12 +37,63 @@ struct PrimEdge {
     MSTree computeMST(const Graph &graph) override;
 };
 
+// Prim's Algorithm over the graph's CSR adjacency, with an indexed 4-ary heap that supports
+// decrease-key in place. Spans every component, so it returns a forest on a disconnected graph.
+class HeapPrimMST : public MSTStrategy
+{
+public:
+    MSTree computeMST(const Graph &graph) override;
+};
+
 // Kruskal's Algorithm implementation
 class KruskalMST : public MSTStrategy
 {
 public:
     MSTree computeMST(const Graph &graph);
 };
+// Filter-Kruskal: splits the edges around a pivot weight and solves the light side first, then
+// drops the heavy edges that would close a cycle before they are ever sorted. Partitions of at
+// most max(V, 1024) edges are LSD radix-sorted on the order-preserving bit pattern of their weights.
+class FilterKruskalMST : public MSTStrategy
+{
+public:
+    MSTree computeMST(const Graph &graph) override;
+};
+
+// Kruskal on several threads. A parallel pass drops self-loops and keeps only the lightest of
+// parallel edges, a sample sort splits the rest into weight ranges that the sorter threads sort
+// lightest first, and the calling thread runs the union-find over every range as soon as it is
+// sorted, while the later ones are still being sorted.
+class ParallelKruskalMST : public MSTStrategy
+{
+public:
+    // 0 threads means std::thread::hardware_concurrency()
+    explicit ParallelKruskalMST(size_t numThreads = 0);
+    MSTree computeMST(const Graph &graph) override;
+
+private:
+    size_t numThreads_;
+};
+
+// Parallel Boruvka's Algorithm implementation
+class BoruvkaMST : public MSTStrategy
+{
+public:
+    // 0 threads means std::thread::hardware_concurrency()
+    explicit BoruvkaMST(size_t numThreads = 0);
+    MSTree computeMST(const Graph &graph) override;
+
+private:
+    size_t numThreads_;
+};
+
+// Returns the minimum spanning forest the graph maintains incrementally across Newedge/Removeedge
+class DynamicMST : public MSTStrategy
+{
+public:
+    MSTree computeMST(const Graph &graph) override;
+};
+
 // Factory for creating MST strategy objects
 class MSTFactory
 {
@@ -50,7 +101,12 @@ public:
     enum MSTType
     {
         PRIM,
-        KRUSKAL
+        PRIM_HEAP,
+        KRUSKAL,
+        FILTER_KRUSKAL,
+        PARALLEL_KRUSKAL,
+        BORUVKA,
+        DYNAMIC
     };
 
     std::unique_ptr<MSTStrategy> getMSTStrategy(MSTType type);
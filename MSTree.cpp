@@ -1,12 +1,10 @@
 #include "MSTree.hpp"
 #include <iostream>
 #include <limits>
-#include <sstream>
-#include <unistd.h>
 
 using namespace std;
 
-MSTree::MSTree() : totalWeight_(0) {}
+MSTree::MSTree() : totalWeight_(0), numVertices_(0) {}
 
 void MSTree::addEdge(const Edge &edge)
 {
@@ -19,150 +17,194 @@ void MSTree::addEdge(const Edge &edge)
 }
 
 
-void MSTree::printMST(int fd)
+void MSTree::printMST(Response &out) const
 {
-    if (fd == -1)
+    out << "MST Edges:\n";
+    for (const auto &edge : mstEdges_)
     {
-        cout << "MST Edges:\n";
-        for (const auto &edge : mstEdges_)
-        {
-            cout << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << endl;
-        }
-    }
-    else
-    {
-        ostringstream oss;
-        oss << "MST Edges:\n";
-        for (const auto &edge : mstEdges_)
-        {
-            oss << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << endl;
-        }
-        string output = oss.str();
-        write(fd, output.c_str(), output.size());
+        out << "Edge (" << edge.v1_ << ", " << edge.v2_ << ") -> Weight: " << edge.weight_ << '\n';
     }
 }
 
-vector<double> MSTree::bfs(int start)
+void MSTree::walkComponent(int root, vector<int> &order, vector<int> &parent, vector<double> &parentWeight, vector<double> &dist) const
 {
-    vector<double> distances(numVertices_, numeric_limits<double>::max());
-    queue<int> q;
-    distances[start] = 0;
-    q.push(start);
+    vector<int> stack;
+    stack.push_back(root);
+    parent[root] = -1;
+    dist[root] = 0;
 
-    while (!q.empty())
+    while (!stack.empty())
     {
-        int node = q.front();
-        q.pop();
+        int node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
 
-        for (auto &neighbor : adjList[node])
+        for (const auto &neighbor : adjList[node])
         {
             int nextNode = neighbor.first;
-            double weight = neighbor.second;
-
-            // Update distance if a shorter path is found
-            if (distances[node] + weight < distances[nextNode])
+            if (parent[nextNode] == -2)
             {
-                distances[nextNode] = distances[node] + weight;
-                q.push(nextNode);
+                parent[nextNode] = node;
+                parentWeight[nextNode] = neighbor.second;
+                dist[nextNode] = dist[node] + neighbor.second;
+                stack.push_back(nextNode);
             }
         }
     }
-
-    return distances;
-}
-double MSTree::getTotalWeight(){
-    return totalWeight_;
 }
-// Find the shortest distance between all pairs of vertices
-double MSTree::findShortestDistance()
+
+double MSTree::sumPairDistances(long long &pairs, vector<int> &farthest) const
 {
-    double shortestDistance = numeric_limits<double>::max();
-    for (int i = 0; i < numVertices_; ++i)
+    vector<int> order, parent(numVertices_, -2);
+    vector<double> parentWeight(numVertices_, 0), dist(numVertices_, 0);
+    vector<long long> subtreeSize(numVertices_, 1);
+    double totalDistance = 0;
+    pairs = 0;
+    order.reserve(numVertices_);
+
+    for (int root = 0; root < numVertices_; ++root)
     {
-        vector<double> distances = bfs(i);
-        for (int j = 0; j < numVertices_; ++j)
+        if (parent[root] != -2)
         {
-            if (i != j && distances[j] < shortestDistance)
+            continue;
+        }
+        size_t first = order.size();
+        walkComponent(root, order, parent, parentWeight, dist);
+        long long componentSize = order.size() - first;
+        pairs += componentSize * (componentSize - 1) / 2;
+
+        // Walk the preorder backwards so that every child is done before its parent.
+        // The edge (node, parent) lies on the path of exactly size * (componentSize - size) pairs.
+        int far = root;
+        for (size_t i = order.size(); i-- > first;)
+        {
+            int node = order[i];
+            if (dist[node] > dist[far])
+            {
+                far = node;
+            }
+            if (parent[node] >= 0)
             {
-                shortestDistance = distances[j];
+                totalDistance += parentWeight[node] * subtreeSize[node] * (componentSize - subtreeSize[node]);
+                subtreeSize[parent[node]] += subtreeSize[node];
             }
         }
+        farthest.push_back(far);
     }
-    return shortestDistance;
+    return totalDistance;
 }
 
-// Helper function to perform DFS and return the farthest node and its distance
-pair<int, double> MSTree::dfs(int node, int parent, vector<bool> &visited)
+double MSTree::diameterFrom(const vector<int> &farthest) const
 {
-    visited[node] = true;
-    pair<int, double> farthest = {node, 0}; // {farthest node, distance}
+    vector<int> order, parent(numVertices_, -2);
+    vector<double> parentWeight(numVertices_, 0), dist(numVertices_, 0);
+    double longest = 0;
+    order.reserve(numVertices_);
 
-    for (const auto &neighbor : adjList[node])
+    for (int start : farthest)
     {
-        int nextNode = neighbor.first;
-        double weight = neighbor.second;
-
-        if (nextNode != parent)
-        {
-            auto result = dfs(nextNode, node, visited);
-            result.second += weight; // Accumulate the distance
-
-            if (result.second > farthest.second)
-            {
-                farthest = result;
-            }
-        }
+        walkComponent(start, order, parent, parentWeight, dist);
     }
+    for (int node : order)
+    {
+        longest = max(longest, dist[node]);
+    }
+    return longest;
+}
 
-    return farthest;
+double MSTree::getTotalWeight() const {
+    return totalWeight_;
 }
 
-double MSTree::findLongestDistance()
+// The shortest path between two distinct vertices of a tree is a single edge
+double MSTree::findShortestDistance() const
 {
-    double ans;
-    // Step 1: Perform DFS from any node (say node 0) to find the farthest node
-    vector<bool> visited(numVertices_, false);
-    auto farthestFromStart = dfs(0, -1, visited);
-
-    // Step 2: Reset the visited vector and perform DFS from the farthest node found
-    fill(visited.begin(), visited.end(), false);
-    auto farthest = dfs(farthestFromStart.first, -1, visited);
-
-    // The second DFS gives the longest distance
-    ans = farthest.second;
-
-    //cout << "Longest Distance: " << ans << endl;
-    return ans;
+    if (cachedMetrics_ & METRIC_SHORTEST_DISTANCE)
+    {
+        return metrics_.shortestDistance;
+    }
+    double shortestDistance = numeric_limits<double>::max();
+    for (const auto &edge : mstEdges_)
+    {
+        shortestDistance = min(shortestDistance, edge.weight_);
+    }
+    return shortestDistance;
 }
 
-// Find the average distance between all pairs of vertices
-double MSTree::findAverageDistance()
+double MSTree::findLongestDistance() const
 {
-    double ans = 0;
-    double totalDistance = 0;
-    int count = 0;
+    if (cachedMetrics_ & METRIC_LONGEST_DISTANCE)
+    {
+        return metrics_.longestDistance;
+    }
+    // Step 1: find the farthest vertex from an arbitrary root of every component
+    // Step 2: the farthest distance from that vertex is the diameter of the component
+    long long pairs;
+    vector<int> farthest;
+    sumPairDistances(pairs, farthest);
+    return diameterFrom(farthest);
+}
 
-    for (int i = 0; i < numVertices_; ++i)
+// Find the average distance between all pairs of connected vertices
+double MSTree::findAverageDistance() const
+{
+    if (cachedMetrics_ & METRIC_AVERAGE_DISTANCE)
     {
-        vector<double> distances = bfs(i);
-
-        for (int j = i + 1; j < numVertices_; ++j)
-        { // Avoid double-counting
-            if (distances[j] < numeric_limits<double>::max())
-            { // Only consider valid paths
-                totalDistance += distances[j];
-                ++count;
-            }
-        }
+        return metrics_.averageDistance;
     }
+    long long pairs;
+    vector<int> farthest;
+    double totalDistance = sumPairDistances(pairs, farthest);
+    return pairs > 0 ? totalDistance / pairs : 0;
+}
+
+TreeMetrics MSTree::computeMetrics() const
+{
+    TreeMetrics metrics;
+    long long pairs;
+    vector<int> farthest;
+    double totalDistance = sumPairDistances(pairs, farthest);
+
+    metrics.totalWeight = totalWeight_;
+    metrics.longestDistance = diameterFrom(farthest);
+    metrics.averageDistance = pairs > 0 ? totalDistance / pairs : 0;
+    metrics.shortestDistance = findShortestDistance();
+    return metrics;
+}
 
-    if (count > 0)
+void MSTree::cacheMetrics(unsigned metrics)
+{
+    metrics_.totalWeight = totalWeight_;
+    if (metrics & (METRIC_LONGEST_DISTANCE | METRIC_AVERAGE_DISTANCE))
     {
-        ans = totalDistance / count;
+        // Both come out of the same pass, so keep both even if only one was asked for
+        long long pairs;
+        vector<int> farthest;
+        double totalDistance = sumPairDistances(pairs, farthest);
+        metrics_.averageDistance = pairs > 0 ? totalDistance / pairs : 0;
+        if (metrics & METRIC_LONGEST_DISTANCE)
+        {
+            metrics_.longestDistance = diameterFrom(farthest);
+            cachedMetrics_ |= METRIC_LONGEST_DISTANCE;
+        }
+        cachedMetrics_ |= METRIC_AVERAGE_DISTANCE;
     }
-    else
+    if (metrics & METRIC_SHORTEST_DISTANCE)
     {
-        ans = 0; // Handle the case where no valid distances were found
+        metrics_.shortestDistance = findShortestDistance();
+        cachedMetrics_ |= METRIC_SHORTEST_DISTANCE;
     }
-    return ans;
+    cachedMetrics_ |= METRIC_TOTAL_WEIGHT;
+}
+
+void MSTree::printMetrics(Response &out, unsigned metrics) const
+{
+    if (metrics & METRIC_TOTAL_WEIGHT)
+        out << "TotalWeight: " << getTotalWeight() << '\n';
+    if (metrics & METRIC_LONGEST_DISTANCE)
+        out << "LongestDistance: " << findLongestDistance() << '\n';
+    if (metrics & METRIC_AVERAGE_DISTANCE)
+        out << "AverageDistance: " << findAverageDistance() << '\n';
+    if (metrics & METRIC_SHORTEST_DISTANCE)
+        out << "ShortestDistance: " << findShortestDistance() << '\n';
 }
@@ -2,10 +2,30 @@
 #define MSTREE_HPP
 
 #include "Graph.hpp"
+#include "response.hpp"
 #include <vector>
 #include <queue>
 #include <algorithm>
 
+// All the distance metrics of a tree, computed together by MSTree::computeMetrics()
+struct TreeMetrics
+{
+    double totalWeight;      // Sum of the weights of the tree edges
+    double longestDistance;  // Diameter: longest distance between two vertices
+    double averageDistance;  // Average distance over every connected pair of vertices
+    double shortestDistance; // Shortest distance between two distinct vertices
+};
+
+// Bit flags selecting a subset of the metrics above
+enum MetricFlags : unsigned
+{
+    METRIC_TOTAL_WEIGHT = 1 << 0,
+    METRIC_LONGEST_DISTANCE = 1 << 1,
+    METRIC_AVERAGE_DISTANCE = 1 << 2,
+    METRIC_SHORTEST_DISTANCE = 1 << 3,
+    METRIC_ALL = (1 << 4) - 1
+};
+
 class MSTree
 {
 public:
@@ -15,19 +35,44 @@ public:
     // double averageDistance_;     // Average distance between every two edges in the graph
     int numVertices_;
     std::vector<std::vector<std::pair<int, double>>> adjList; // Adjacency list with weights
-    std::vector<double> bfs(int start);
-    std::pair<int, double> dfs(int node, int parent, std::vector<bool>& visited) ;
     MSTree() ;
     MSTree(int numVertices) : totalWeight_(0), numVertices_(numVertices)
     {
         adjList.resize(numVertices_); // Initialize adjList with the number of vertices
     }
     void addEdge(const Edge &edge);
-    void printMST(int fd);
-    double findLongestDistance();
-    double findAverageDistance();
-    double findShortestDistance();
-    double getTotalWeight();
+    void printMST(Response &out) const;
+    double findLongestDistance() const;
+    double findAverageDistance() const;
+    double findShortestDistance() const;
+    double getTotalWeight() const;
+    // Compute all the metrics in at most two linear passes over adjList
+    TreeMetrics computeMetrics() const;
+    // Compute the selected metrics once and keep them, so their find* methods above become O(1).
+    // Must be called before the tree is shared between threads.
+    void cacheMetrics(unsigned metrics = METRIC_ALL);
+    // MetricFlags of the metrics kept by cacheMetrics()
+    unsigned getCachedMetrics() const
+    {
+        return cachedMetrics_;
+    }
+    // One "<Name>: <value>" line per selected metric, in the order of MetricFlags
+    void printMetrics(Response &out, unsigned metrics) const;
+
+private:
+    // Iterative DFS over the component of root. Appends the visited vertices to order (preorder)
+    // and fills parent, parentWeight and dist (from root) for them. Vertices with parent != -2 are
+    // treated as already visited.
+    void walkComponent(int root, std::vector<int> &order, std::vector<int> &parent,
+                       std::vector<double> &parentWeight, std::vector<double> &dist) const;
+    TreeMetrics metrics_;          // Only the fields selected by cachedMetrics_ are valid
+    unsigned cachedMetrics_ = 0;
+
+    // Sum of the distances over all connected pairs, using each edge's subtree-size contribution.
+    // Also reports the farthest vertex from the root of every component (diameter endpoints).
+    double sumPairDistances(long long &pairs, std::vector<int> &farthest) const;
+    // Second pass of the two-pass diameter trick, starting from the given endpoints
+    double diameterFrom(const std::vector<int> &farthest) const;
 };
 
 #endif // MSTREE_HPP
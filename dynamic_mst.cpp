@@ -0,0 +1,748 @@
+#include "dynamic_mst.hpp"
+#include "union_find.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+void LinkCutTree::resize(int numNodes)
+{
+    int oldSize = nodes_.size();
+    nodes_.resize(numNodes);
+    for (int i = oldSize; i < numNodes; ++i)
+    {
+        nodes_[i].weight = -numeric_limits<double>::infinity();
+        nodes_[i].best = i;
+    }
+}
+
+void LinkCutTree::setWeight(int node, double weight)
+{
+    access(node);
+    splay(node);
+    nodes_[node].weight = weight;
+    pull(node);
+}
+
+bool LinkCutTree::isRoot(int x) const
+{
+    int p = nodes_[x].parent;
+    return p == -1 || (nodes_[p].child[0] != x && nodes_[p].child[1] != x);
+}
+
+void LinkCutTree::push(int x)
+{
+    if (nodes_[x].reversed)
+    {
+        swap(nodes_[x].child[0], nodes_[x].child[1]);
+        for (int c : nodes_[x].child)
+        {
+            if (c != -1)
+                nodes_[c].reversed = !nodes_[c].reversed;
+        }
+        nodes_[x].reversed = false;
+    }
+}
+
+void LinkCutTree::pull(int x)
+{
+    int best = x;
+    for (int c : nodes_[x].child)
+    {
+        if (c != -1 && nodes_[nodes_[c].best].weight > nodes_[best].weight)
+            best = nodes_[c].best;
+    }
+    nodes_[x].best = best;
+}
+
+void LinkCutTree::rotate(int x)
+{
+    int p = nodes_[x].parent, g = nodes_[p].parent;
+    int side = nodes_[p].child[1] == x;
+    int moved = nodes_[x].child[!side];
+    if (!isRoot(p))
+        nodes_[g].child[nodes_[g].child[1] == p] = x;
+    nodes_[x].parent = g;
+    nodes_[x].child[!side] = p;
+    nodes_[p].parent = x;
+    nodes_[p].child[side] = moved;
+    if (moved != -1)
+        nodes_[moved].parent = p;
+    pull(p);
+    pull(x);
+}
+
+void LinkCutTree::splay(int x)
+{
+    // Push pending reversals from the splay root down to x first
+    vector<int> path = {x};
+    for (int y = x; !isRoot(y); y = nodes_[y].parent)
+        path.push_back(nodes_[y].parent);
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        push(*it);
+
+    while (!isRoot(x))
+    {
+        int p = nodes_[x].parent;
+        if (!isRoot(p))
+        {
+            int g = nodes_[p].parent;
+            rotate((nodes_[g].child[1] == p) == (nodes_[p].child[1] == x) ? p : x);
+        }
+        rotate(x);
+    }
+}
+
+void LinkCutTree::access(int x)
+{
+    for (int last = -1, y = x; y != -1; last = y, y = nodes_[y].parent)
+    {
+        splay(y);
+        nodes_[y].child[1] = last;
+        pull(y);
+    }
+    splay(x);
+}
+
+void LinkCutTree::makeRoot(int x)
+{
+    access(x);
+    nodes_[x].reversed = !nodes_[x].reversed;
+}
+
+int LinkCutTree::findRoot(int x)
+{
+    access(x);
+    while (true)
+    {
+        push(x);
+        if (nodes_[x].child[0] == -1)
+            break;
+        x = nodes_[x].child[0];
+    }
+    splay(x);
+    return x;
+}
+
+void LinkCutTree::link(int x, int y)
+{
+    makeRoot(x);
+    nodes_[x].parent = y;
+}
+
+void LinkCutTree::cut(int x, int y)
+{
+    makeRoot(x);
+    access(y);
+    // x is now the left child of y with nothing in between
+    nodes_[y].child[0] = -1;
+    nodes_[x].parent = -1;
+    pull(y);
+}
+
+bool LinkCutTree::connected(int x, int y)
+{
+    return x == y || findRoot(x) == findRoot(y);
+}
+
+int LinkCutTree::pathMax(int x, int y)
+{
+    makeRoot(x);
+    access(y);
+    return nodes_[y].best;
+}
+
+int EulerTourForest::addNode(int item, bool isVertex)
+{
+    int x;
+    if (freeNodes_.empty())
+    {
+        x = nodes_.size();
+        nodes_.emplace_back();
+    }
+    else
+    {
+        x = freeNodes_.back();
+        freeNodes_.pop_back();
+        nodes_[x] = Node();
+    }
+    // xorshift32, treap priorities only need to look random
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    Node &node = nodes_[x];
+    node.priority = seed_;
+    node.item = item;
+    node.isVertex = isVertex;
+    node.key[0] = node.key[1] = numeric_limits<double>::infinity();
+    update(x);
+    return x;
+}
+
+int EulerTourForest::root(int x) const
+{
+    while (nodes_[x].parent != -1)
+        x = nodes_[x].parent;
+    return x;
+}
+
+int EulerTourForest::position(int x) const
+{
+    int pos = size(nodes_[x].left);
+    for (int p = nodes_[x].parent; p != -1; x = p, p = nodes_[p].parent)
+    {
+        if (nodes_[p].right == x)
+            pos += size(nodes_[p].left) + 1;
+    }
+    return pos;
+}
+
+void EulerTourForest::update(int x)
+{
+    Node &node = nodes_[x];
+    node.size = 1;
+    node.vertices = node.isVertex;
+    node.flagged = node.flag;
+    for (int which = 0; which < 2; ++which)
+        node.minNode[which] = node.key[which] < numeric_limits<double>::infinity() ? x : -1;
+    for (int c : {node.left, node.right})
+    {
+        if (c == -1)
+            continue;
+        const Node &child = nodes_[c];
+        node.size += child.size;
+        node.vertices += child.vertices;
+        node.flagged += child.flagged;
+        for (int which = 0; which < 2; ++which)
+        {
+            int m = child.minNode[which];
+            if (m != -1 && (node.minNode[which] == -1 || nodes_[m].key[which] < nodes_[node.minNode[which]].key[which]))
+                node.minNode[which] = m;
+        }
+    }
+}
+
+void EulerTourForest::updateUp(int x)
+{
+    for (; x != -1; x = nodes_[x].parent)
+        update(x);
+}
+
+int EulerTourForest::merge(int a, int b)
+{
+    if (a == -1 || b == -1)
+        return a == -1 ? b : a;
+    if (nodes_[a].priority > nodes_[b].priority)
+    {
+        int right = merge(nodes_[a].right, b);
+        nodes_[a].right = right;
+        nodes_[right].parent = a;
+        update(a);
+        return a;
+    }
+    int left = merge(a, nodes_[b].left);
+    nodes_[b].left = left;
+    nodes_[left].parent = b;
+    update(b);
+    return b;
+}
+
+void EulerTourForest::split(int t, int k, int &left, int &right)
+{
+    if (t == -1)
+    {
+        left = right = -1;
+        return;
+    }
+    if (k <= size(nodes_[t].left))
+    {
+        int inner;
+        split(nodes_[t].left, k, left, inner);
+        nodes_[t].left = inner;
+        if (inner != -1)
+            nodes_[inner].parent = t;
+        right = t;
+    }
+    else
+    {
+        int inner;
+        split(nodes_[t].right, k - size(nodes_[t].left) - 1, inner, right);
+        nodes_[t].right = inner;
+        if (inner != -1)
+            nodes_[inner].parent = t;
+        left = t;
+    }
+    update(t);
+    // The caller owns the two halves as separate trees
+    if (left != -1)
+        nodes_[left].parent = -1;
+    if (right != -1)
+        nodes_[right].parent = -1;
+}
+
+int EulerTourForest::reroot(int x)
+{
+    int left, right;
+    split(root(x), position(x), left, right);
+    return merge(right, left);
+}
+
+void EulerTourForest::link(int u, int w, int uw, int wu)
+{
+    int tourU = reroot(u);
+    int tourW = reroot(w);
+    merge(merge(merge(tourU, uw), tourW), wu);
+}
+
+void EulerTourForest::cut(int uw, int wu)
+{
+    if (position(uw) > position(wu))
+        swap(uw, wu);
+    // The tour is A uw B wu C, where B is the tour of the far side
+    int a, rest, self, b, c;
+    int first = position(uw), second = position(wu);
+    split(root(uw), first, a, rest);
+    split(rest, 1, self, rest);
+    split(rest, second - first - 1, b, rest);
+    split(rest, 1, self, c);
+    merge(a, c);
+    freeNodes_.push_back(uw);
+    freeNodes_.push_back(wu);
+}
+
+void EulerTourForest::build(const vector<int> &tour)
+{
+    // Cartesian tree of the priorities along the tour. A node leaves the stack once its subtree is
+    // complete, which is when its totals can be computed.
+    vector<int> stack;
+    for (int x : tour)
+    {
+        int last = -1;
+        while (!stack.empty() && nodes_[stack.back()].priority < nodes_[x].priority)
+        {
+            last = stack.back();
+            stack.pop_back();
+            update(last);
+        }
+        nodes_[x].left = last;
+        if (last != -1)
+            nodes_[last].parent = x;
+        if (!stack.empty())
+        {
+            nodes_[stack.back()].right = x;
+            nodes_[x].parent = stack.back();
+        }
+        stack.push_back(x);
+    }
+    for (; !stack.empty(); stack.pop_back())
+        update(stack.back());
+}
+
+void EulerTourForest::setFlag(int node, bool flag)
+{
+    nodes_[node].flag = flag;
+    updateUp(node);
+}
+
+void EulerTourForest::setKey(int node, int which, double key)
+{
+    nodes_[node].key[which] = key;
+    updateUp(node);
+}
+
+int EulerTourForest::findFlagged(int node) const
+{
+    int x = root(node);
+    if (nodes_[x].flagged == 0)
+        return -1;
+    while (!nodes_[x].flag)
+    {
+        int left = nodes_[x].left;
+        x = left != -1 && nodes_[left].flagged > 0 ? left : nodes_[x].right;
+    }
+    return x;
+}
+
+static uint64_t pairKey(int v1, int v2)
+{
+    return (uint64_t)(uint32_t)min(v1, v2) << 32 | (uint32_t)max(v1, v2);
+}
+
+DynamicForest::DynamicForest(const Graph &graph) : numVertices_(graph.numVertices_)
+{
+    const auto &graphEdges = graph.edges();
+    edges_.reserve(graphEdges.size());
+    nextId_.reserve(graphEdges.size());
+    pairIndex_.reserve(graphEdges.size());
+    vector<pair<double, int>> order; // Weight and id of every edge that is not a self loop
+    order.reserve(graphEdges.size());
+    for (const auto &edge : graphEdges)
+    {
+        if (edge.isRemoved())
+            continue;
+        int id = newEdge(edge.v1_, edge.v2_, edge.weight_);
+        if (edge.v1_ != edge.v2_)
+            order.push_back({edge.weight_, id});
+    }
+    lct_.resize(numVertices_ + edges_.size());
+    for (size_t id = 0; id < edges_.size(); ++id)
+        lct_.setWeight(edgeNode(id), edges_[id].weight);
+
+    // Every edge starts at level 0: the Kruskal forest in the tours, the rest at their endpoints
+    sort(order.begin(), order.end());
+    UnionFind uf(numVertices_);
+    vector<int> treeStart(numVertices_ + 1, 0), treeAdjacent;
+    for (int v = 0; v < numVertices_; ++v)
+        vertexLevel(0, v);
+    for (const auto &[weight, id] : order)
+    {
+        DynamicEdge &edge = edges_[id];
+        if (uf.unite(edge.v1, edge.v2))
+        {
+            edge.inTree = true;
+            edge.treePos = treeEdges_.size();
+            treeEdges_.push_back(id);
+            ++treeStart[edge.v1 + 1];
+            ++treeStart[edge.v2 + 1];
+            continue;
+        }
+        // In weight order, so every insert goes at the end
+        for (int v : {edge.v1, edge.v2})
+        {
+            auto &nonTree = vertexLevel(0, v).nonTree;
+            nonTree.emplace_hint(nonTree.end(), edge.weight, id);
+        }
+    }
+    for (int v = 0; v < numVertices_; ++v)
+    {
+        treeStart[v + 1] += treeStart[v];
+        updateKeys(0, v); // While every tour is a single node
+    }
+    treeAdjacent.resize(treeStart[numVertices_]);
+    vector<int> filled(treeStart.begin(), treeStart.end() - 1);
+    for (int id : treeEdges_)
+    {
+        treeAdjacent[filled[edges_[id].v1]++] = id;
+        treeAdjacent[filled[edges_[id].v2]++] = id;
+    }
+
+    // Walk every tree from its first vertex: hang each vertex below the edge it was reached by,
+    // and write the tour as the vertex, then for each child an arc down, its tour and an arc up
+    vector<bool> visited(numVertices_, false);
+    vector<int> tour;
+    vector<pair<int, int>> stack; // Vertex and its next position in treeAdjacent
+    for (int root = 0; root < numVertices_; ++root)
+    {
+        if (visited[root])
+            continue;
+        visited[root] = true;
+        tour.assign(1, vertexNode(0, root));
+        stack.assign(1, {root, treeStart[root]});
+        while (!stack.empty())
+        {
+            auto &[v, next] = stack.back();
+            if (next == treeStart[v + 1])
+            {
+                stack.pop_back();
+                if (!stack.empty())
+                    tour.push_back(edges_[treeAdjacent[stack.back().second - 1]].arcs[1]);
+                continue;
+            }
+            int id = treeAdjacent[next++];
+            DynamicEdge &edge = edges_[id];
+            int child = edge.v1 == v ? edge.v2 : edge.v1;
+            if (visited[child])
+                continue;
+            visited[child] = true;
+            lct_.hang(child, edgeNode(id));
+            lct_.hang(edgeNode(id), v);
+            edge.arcs = {tours_.addNode(id, false), tours_.addNode(id, false)};
+            tours_.setFlag(edge.arcs[0], true);
+            tour.push_back(edge.arcs[0]);
+            tour.push_back(vertexNode(0, child));
+            stack.push_back({child, treeStart[child]});
+        }
+        tours_.build(tour);
+    }
+}
+
+int DynamicForest::newEdge(int v1, int v2, double weight)
+{
+    int id;
+    if (freeIds_.empty())
+    {
+        id = edges_.size();
+        edges_.push_back({v1, v2, weight, false, -1, 0, {}});
+        nextId_.push_back(-1);
+    }
+    else
+    {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+        edges_[id] = {v1, v2, weight, false, -1, 0, {}};
+        nextId_[id] = -1;
+    }
+    auto inserted = pairIndex_.try_emplace(pairKey(v1, v2), IdChain{id, id});
+    if (!inserted.second)
+    {
+        IdChain &chain = inserted.first->second;
+        nextId_[chain.tail] = id;
+        chain.tail = id;
+    }
+    return id;
+}
+
+DynamicForest::VertexLevel &DynamicForest::vertexLevel(int level, int v)
+{
+    if ((int)vertexLevelIds_.size() <= level)
+        vertexLevelIds_.resize(level + 1);
+    if (vertexLevelIds_[level].empty())
+        vertexLevelIds_[level].assign(numVertices_, -1);
+    int index = vertexLevelIds_[level][v];
+    if (index != -1)
+        return vertexLevels_[index];
+    int node = tours_.addNode(v, true);
+    // The second key follows the lightest non-tree edge of v one level down
+    if (level > 0 && vertexLevelIds_[level - 1][v] != -1)
+    {
+        const auto &below = vertexLevels_[vertexLevelIds_[level - 1][v]].nonTree;
+        if (!below.empty())
+            tours_.setKey(node, 1, below.begin()->first);
+    }
+    vertexLevelIds_[level][v] = vertexLevels_.size();
+    vertexLevels_.push_back({node, {}});
+    return vertexLevels_.back();
+}
+
+void DynamicForest::updateKeys(int level, int v)
+{
+    const VertexLevel &vl = vertexLevel(level, v);
+    double lightest = vl.nonTree.empty() ? numeric_limits<double>::infinity() : vl.nonTree.begin()->first;
+    tours_.setKey(vl.node, 0, lightest);
+    if (level + 1 < (int)vertexLevelIds_.size() && !vertexLevelIds_[level + 1].empty() &&
+        vertexLevelIds_[level + 1][v] != -1)
+    {
+        tours_.setKey(vertexLevels_[vertexLevelIds_[level + 1][v]].node, 1, lightest);
+    }
+}
+
+void DynamicForest::attach(int id)
+{
+    DynamicEdge &edge = edges_[id];
+    lct_.link(edge.v1, edgeNode(id));
+    lct_.link(edgeNode(id), edge.v2);
+    for (int level = 0; level <= edge.level; ++level)
+    {
+        int uw = tours_.addNode(id, false);
+        int wu = tours_.addNode(id, false);
+        tours_.link(vertexNode(level, edge.v1), vertexNode(level, edge.v2), uw, wu);
+        edge.arcs.push_back(uw);
+        edge.arcs.push_back(wu);
+    }
+    tours_.setFlag(edge.arcs[2 * edge.level], true); // Found when its tree moves up a level
+    edge.inTree = true;
+    edge.treePos = treeEdges_.size();
+    treeEdges_.push_back(id);
+}
+
+void DynamicForest::detach(int id)
+{
+    DynamicEdge &edge = edges_[id];
+    lct_.cut(edge.v1, edgeNode(id));
+    lct_.cut(edgeNode(id), edge.v2);
+    for (size_t i = 0; i < edge.arcs.size(); i += 2)
+        tours_.cut(edge.arcs[i], edge.arcs[i + 1]);
+    edge.arcs.clear();
+    edge.inTree = false;
+    // Swap-remove from the tree edge list
+    int last = treeEdges_.back();
+    treeEdges_[edge.treePos] = last;
+    edges_[last].treePos = edge.treePos;
+    treeEdges_.pop_back();
+}
+
+void DynamicForest::raiseTreeEdge(int id)
+{
+    DynamicEdge &edge = edges_[id];
+    tours_.setFlag(edge.arcs[2 * edge.level], false);
+    ++edge.level;
+    int uw = tours_.addNode(id, false);
+    int wu = tours_.addNode(id, false);
+    tours_.link(vertexNode(edge.level, edge.v1), vertexNode(edge.level, edge.v2), uw, wu);
+    tours_.setFlag(uw, true);
+    edge.arcs.push_back(uw);
+    edge.arcs.push_back(wu);
+}
+
+void DynamicForest::addNonTree(int id)
+{
+    const DynamicEdge &edge = edges_[id];
+    for (int v : {edge.v1, edge.v2})
+    {
+        vertexLevel(edge.level, v).nonTree.emplace(edge.weight, id);
+        updateKeys(edge.level, v);
+    }
+}
+
+void DynamicForest::removeNonTree(int id)
+{
+    const DynamicEdge &edge = edges_[id];
+    for (int v : {edge.v1, edge.v2})
+    {
+        vertexLevel(edge.level, v).nonTree.erase({edge.weight, id});
+        updateKeys(edge.level, v);
+    }
+}
+
+void DynamicForest::moveNonTree(int id, int level)
+{
+    removeNonTree(id);
+    edges_[id].level = level;
+    addNonTree(id);
+}
+
+void DynamicForest::addEdge(int v1, int v2, double weight)
+{
+    int id = newEdge(v1, v2, weight);
+    lct_.resize(numVertices_ + edges_.size());
+    lct_.setWeight(edgeNode(id), weight);
+
+    if (v1 == v2)
+    {
+        return; // A self loop never belongs to the forest
+    }
+    if (!lct_.connected(v1, v2))
+    {
+        attach(id);
+        return;
+    }
+    addNonTree(id);
+    // The new edge closes a cycle. If it is lighter than the heaviest edge on it, that edge leaves
+    // the forest as a level 0 non-tree edge, and the search for its replacement finds the new edge:
+    // nothing lighter crosses the cut. The search also moves down the crossing edges of higher
+    // levels, whose endpoints the new level 0 tree edge now connects.
+    int heaviest = lct_.pathMax(v1, v2) - numVertices_;
+    if (weight < edges_[heaviest].weight)
+    {
+        int level = edges_[heaviest].level;
+        detach(heaviest);
+        edges_[heaviest].level = 0;
+        addNonTree(heaviest);
+        reconnect(edges_[heaviest].v1, edges_[heaviest].v2, level);
+    }
+}
+
+void DynamicForest::removeEdge(int v1, int v2)
+{
+    auto it = pairIndex_.find(pairKey(v1, v2));
+    if (it == pairIndex_.end())
+    {
+        return;
+    }
+    int id = it->second.head;
+    if (id == it->second.tail)
+    {
+        pairIndex_.erase(it);
+    }
+    else
+    {
+        it->second.head = nextId_[id];
+    }
+    freeIds_.push_back(id);
+    const DynamicEdge &removed = edges_[id];
+    if (removed.v1 == removed.v2)
+    {
+        return;
+    }
+    if (!removed.inTree)
+    {
+        removeNonTree(id); // Removing a non-tree edge leaves the forest unchanged
+        return;
+    }
+    int level = removed.level;
+    detach(id);
+    reconnect(removed.v1, removed.v2, level);
+}
+
+int DynamicForest::smallerSide(int level, int a, int b)
+{
+    return tours_.vertexCount(vertexNode(level, a)) <= tours_.vertexCount(vertexNode(level, b)) ? a : b;
+}
+
+int DynamicForest::findCrossing(int level, int side)
+{
+    int node;
+    while ((node = tours_.findMin(vertexNode(level, side), 0)) != -1)
+    {
+        int id = vertexLevel(level, tours_.item(node)).nonTree.begin()->second;
+        const DynamicEdge &edge = edges_[id];
+        if (!tours_.connected(vertexNode(level, edge.v1), vertexNode(level, edge.v2)))
+            return id;
+        moveNonTree(id, level + 1); // Both ends on this side, whose tree edges are already one level up
+    }
+    return -1;
+}
+
+void DynamicForest::lowerCrossing(int level, int side, int lowerTo)
+{
+    // Lower levels may have moved tree edges up to this level since, so the side is now found as a
+    // tree of the next level, whose vertex nodes key their non-tree edges of this level
+    int node;
+    while ((node = tours_.findMin(vertexNode(level + 1, side), 1)) != -1)
+    {
+        int id = vertexLevel(level, tours_.item(node)).nonTree.begin()->second;
+        const DynamicEdge &edge = edges_[id];
+        bool inside = tours_.connected(vertexNode(level + 1, edge.v1), vertexNode(level + 1, edge.v2));
+        moveNonTree(id, inside ? level + 1 : lowerTo);
+    }
+}
+
+void DynamicForest::reconnect(int a, int b, int level)
+{
+    // Any edge across the cut has a level of at most `level` and, at its own level, an end in
+    // each half, so each level only has to be searched from its smaller half
+    int best = -1;
+    vector<pair<int, int>> crossingSides; // Level and side of every level with an edge across
+    for (int i = level; i >= 0; --i)
+    {
+        int side = smallerSide(i, a, b);
+        // The smaller half has at most half the vertices of the tree it came from, so it can
+        // become a tree of the next level
+        int arc;
+        while ((arc = tours_.findFlagged(vertexNode(i, side))) != -1)
+        {
+            raiseTreeEdge(tours_.item(arc));
+        }
+        int crossing = findCrossing(i, side);
+        if (crossing != -1)
+        {
+            crossingSides.push_back({i, side});
+            if (best == -1 || edges_[crossing].weight < edges_[best].weight)
+                best = crossing;
+        }
+    }
+    if (best == -1)
+    {
+        return; // The two halves stay apart
+    }
+    // Edges across the cut above the level of the replacement would have their ends connected only
+    // through it: move them down to its level
+    int bestLevel = edges_[best].level;
+    for (const auto &[i, side] : crossingSides)
+    {
+        if (i > bestLevel)
+            lowerCrossing(i, side, bestLevel);
+    }
+    removeNonTree(best);
+    attach(best);
+}
+
+MSTree DynamicForest::getTree() const
+{
+    MSTree mst(numVertices_);
+    for (int id : treeEdges_)
+    {
+        mst.addEdge(Edge(edges_[id].v1, edges_[id].v2, edges_[id].weight));
+    }
+    return mst;
+}
@@ -0,0 +1,218 @@
+#ifndef DYNAMIC_MST_HPP
+#define DYNAMIC_MST_HPP
+
+#include "Graph.hpp"
+#include "MSTree.hpp"
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Link-cut tree over the vertices of a graph plus one node per edge, so that every tree path
+// carries its edge weights. Supports link, cut, connectivity and path-maximum in O(log n) amortized.
+class LinkCutTree
+{
+public:
+    void resize(int numNodes);
+    void setWeight(int node, double weight);
+    void link(int x, int y);
+    // link for an x that is the root of its tree and has not been accessed since, such as a new
+    // node: O(1), for building a forest from the top down
+    void hang(int x, int y)
+    {
+        nodes_[x].parent = y;
+    }
+    void cut(int x, int y);
+    bool connected(int x, int y);
+    // Node holding the largest weight on the tree path between x and y
+    int pathMax(int x, int y);
+
+private:
+    struct Node
+    {
+        int child[2] = {-1, -1};
+        int parent = -1;
+        bool reversed = false;
+        double weight = 0;
+        int best = -1; // Node with the largest weight in this splay subtree
+    };
+    std::vector<Node> nodes_;
+
+    bool isRoot(int x) const;
+    void push(int x);
+    void pull(int x);
+    void rotate(int x);
+    void splay(int x);
+    void access(int x);
+    void makeRoot(int x);
+    int findRoot(int x);
+};
+
+// Euler tours of the trees of a forest, each kept as a treap of its nodes in tour order: one
+// node per vertex and two arc nodes per tree edge. Every node has two keys, +infinity unless set,
+// and a flag. The treap keeps per-subtree vertex counts, flag counts and the node with the
+// smallest value of each key, so the size of a tree, one of its flagged nodes and its node with
+// the smallest key come from the root in O(log n). Link and cut are O(log n) expected.
+class EulerTourForest
+{
+public:
+    // New single-node tree. isVertex nodes count toward the tree size.
+    int addNode(int item, bool isVertex);
+    // Join the trees of vertex nodes u and w, through the new arc nodes uw and wu
+    void link(int u, int w, int uw, int wu);
+    // Split a tree at the edge whose arc nodes are uw and wu, and free them
+    void cut(int uw, int wu);
+    // Join single-node trees into one tree with the given tour, O(n)
+    void build(const std::vector<int> &tour);
+    bool connected(int x, int y) const
+    {
+        return root(x) == root(y);
+    }
+    int vertexCount(int node) const
+    {
+        return nodes_[root(node)].vertices;
+    }
+    void setFlag(int node, bool flag);
+    void setKey(int node, int which, double key);
+    // Any flagged node in the tree of node, or -1
+    int findFlagged(int node) const;
+    // Node with the smallest finite key `which` in the tree of node, or -1
+    int findMin(int node, int which) const
+    {
+        return nodes_[root(node)].minNode[which];
+    }
+    int item(int node) const
+    {
+        return nodes_[node].item;
+    }
+
+private:
+    struct Node
+    {
+        int left = -1, right = -1, parent = -1;
+        uint32_t priority;
+        int item;
+        bool isVertex;
+        bool flag = false;
+        double key[2];
+        // Over the subtree of the node
+        int size = 1;
+        int vertices;
+        int flagged = 0;
+        int minNode[2];
+    };
+    std::vector<Node> nodes_;
+    std::vector<int> freeNodes_;
+    uint32_t seed_ = 2463534242u;
+
+    int root(int x) const;
+    int position(int x) const;
+    int size(int x) const
+    {
+        return x == -1 ? 0 : nodes_[x].size;
+    }
+    void update(int x);
+    // Update x and its ancestors after a change to x
+    void updateUp(int x);
+    int merge(int a, int b);
+    // First k nodes of the treap t into left, the rest into right
+    void split(int t, int k, int &left, int &right);
+    // Rotate the tour of vertex node x so that it starts at x, returns its root
+    int reroot(int x);
+};
+
+// Minimum spanning forest kept up to date while edges are added to or removed from a graph, with
+// the levels of Holm, de Lichtenberg and Thorup. A tree edge of level l is in the Euler tours of
+// levels 0..l, and a non-tree edge is listed, by weight, at both its endpoints for its level. The
+// endpoints of a non-tree edge are always connected by tree edges of at least its level, and a
+// tree of level i has at most V / 2^i vertices.
+// Inserting an edge swaps out the heaviest edge of the cycle it closes, found with a link-cut
+// tree over the forest. Removing a tree edge searches each level from its own down to 0 on the
+// smaller side of the cut: that side's tree edges of the level move up one level, then its
+// non-tree edges of the level are taken lightest first, moving up those with both ends on the
+// side, until one crosses the cut. The lightest crossing edge over all levels reconnects the
+// forest. Every edge moves up at most log V times, so removals cost O(log^2 V) amortized, plus
+// O(log V) for each crossing edge found above the level of the replacement: those are moved down
+// to it, as are the edges a lighter inserted edge takes over from.
+class DynamicForest
+{
+public:
+    // One Kruskal run picks the tree edges, whose tours and link-cut tree are built in one pass
+    explicit DynamicForest(const Graph &graph);
+    void addEdge(int v1, int v2, double weight);
+    // Removes the same edge Graph::removeEdge does: the oldest one between v1 and v2
+    void removeEdge(int v1, int v2);
+    // Snapshot of the current spanning forest, O(V)
+    MSTree getTree() const;
+
+private:
+    struct DynamicEdge
+    {
+        int v1, v2;
+        double weight;
+        bool inTree;
+        int treePos; // Position in treeEdges_ while inTree
+        int level;
+        std::vector<int> arcs; // Tour arc nodes of levels 0..level while inTree, two per level
+    };
+    // A vertex at one level: its tour node and its non-tree edges of that level, lightest first.
+    // The tour node of the vertex one level up keeps the lightest weight as its second key.
+    struct VertexLevel
+    {
+        int node;
+        std::set<std::pair<double, int>> nonTree;
+    };
+    int numVertices_;
+    LinkCutTree lct_;
+    EulerTourForest tours_;
+    std::vector<VertexLevel> vertexLevels_;
+    std::vector<std::vector<int>> vertexLevelIds_; // Per level and vertex, made on first use
+    std::vector<DynamicEdge> edges_;
+    std::vector<int> freeIds_;
+    std::vector<int> treeEdges_; // Ids of the edges currently in the forest
+    // Live edge ids per vertex pair (min, max), oldest first: head and tail of a chain linked
+    // through nextId_, like the slot index of Graph
+    struct IdChain
+    {
+        int head, tail;
+    };
+    std::unordered_map<uint64_t, IdChain> pairIndex_;
+    std::vector<int> nextId_;
+
+    int edgeNode(int id) const
+    {
+        return numVertices_ + id;
+    }
+    // New edge id, listed last for its vertex pair
+    int newEdge(int v1, int v2, double weight);
+    VertexLevel &vertexLevel(int level, int v);
+    int vertexNode(int level, int v)
+    {
+        return vertexLevel(level, v).node;
+    }
+    // The lightest non-tree edge of v at the level changed
+    void updateKeys(int level, int v);
+    // Make the edge a tree edge of its level, or take it out of the forest
+    void attach(int id);
+    void detach(int id);
+    // List a non-tree edge at its level, or take it off
+    void addNonTree(int id);
+    void removeNonTree(int id);
+    void moveNonTree(int id, int level);
+    // Move a tree edge of level i up to level i + 1
+    void raiseTreeEdge(int id);
+    // The tree edge between a and b of the given level was just detached: reconnect the two halves
+    // with the lightest non-tree edge between them, if there is one
+    void reconnect(int a, int b, int level);
+    // Vertex of a and b whose tree of the given level has fewer vertices
+    int smallerSide(int level, int a, int b);
+    // Take the non-tree edges of the level in the tree of side lightest first, moving those with
+    // both ends in it up a level, and return the first one that leaves the tree, or -1
+    int findCrossing(int level, int side);
+    // After findCrossing(level, side) the side is a tree of level + 1. Move every non-tree edge of
+    // the level leaving it down to lowerTo, and those inside it up a level.
+    void lowerCrossing(int level, int side, int lowerTo);
+};
+
+#endif // DYNAMIC_MST_HPP
@@ -1,23 +1,45 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <functional>
 #include "execute_commands.hpp"
 #include "Graph.hpp"
+#include "graph_file.hpp"
+#include "graph_loader.hpp"
+#include "graph_registry.hpp"
+#include "latency_stats.hpp"
 #include "MSTStrategy.hpp"
 #include "MSTree.hpp"
 #include "pipeline.hpp"
+#include "response.hpp"
 #include "LeaderFollowerThreadPool.hpp"
 // #include "kosaraju.h"
 #define COMMANDS_USAGE "enter one of the following commands:\n"                              \
-                       "            Newgraph <verttices>,<edges>\n"                          \
+                       "            Newgraph [name] <verttices>,<edges>\n"                   \
                        "                User should enter <edges> pairs of directed edges\n" \
+                       "            Newgraphbin [name] <verttices>,<edges>\n"                \
+                       "                User should send <edges> {int32,int32,double}\n"    \
+                       "            Loadgraph [name] <path>\n"                               \
+                       "            Savegraph <path>\n"                                      \
+                       "                <path> is relative to the server's data directory\n" \
+                       "            Use <name>\n"                                            \
+                       "            Drop <name>\n"                                           \
+                       "            Stats\n"                                                 \
+                       "            Mode pipeline|lf|inline|both\n"                          \
+                       "            Metrics all|<metric>,<metric>,...\n"                     \
                        "            Newedge <from>,<to>,<weight>\n"                          \
                        "            Removeedge <from>,<to>\n"                                \
                        "            Print\n"                                                 \
-                       "            Prim\n"                                                  \
-                       "            Kruskal\n\n"                                             \
+                       "            Prim [mode]\n"                                           \
+                       "            Primheap [mode]\n"                                       \
+                       "            Kruskal [mode]\n"                                        \
+                       "            Filterkruskal [mode]\n"                                  \
+                       "            Parallelkruskal [mode]\n"                                \
+                       "            Boruvka [mode]\n"                                        \
+                       "            Dynamic [mode]\n\n"                                      \
                        "enter command:\n"
 
 #define MISSING_VERT_EDGE "Must specify verttices and edges\n"
@@ -25,23 +47,156 @@
 #define PRINT_EDGES_MESSAGE \
     "Enter the  directed edges as triplets of vertices <from>,<to>,<weight>:\n"
 
+#define SEND_BINARY_EDGES_MESSAGE "Send the edge block\n"
+
+#define INVALID_EDGE_BLOCK "Edge block is incomplete or malformed\n"
+
 #define MISSING_GRAPH "Graph does not exist, please create a graph\n"
 
+#define MISSING_PATH "Must specify the path of the graph file\n"
+
+#define INVALID_GRAPH_FILE "Cannot load the graph file\n"
+
+#define INVALID_PATH "Path must be relative to the data directory and must not contain ..\n"
+
+#define SAVE_FAILED "Cannot write the graph file\n"
+
+#define MISSING_NAME "Must specify the name of the graph\n"
+
+#define INVALID_MODE "Mode must be one of pipeline, lf, inline, both\n"
+
+#define INVALID_METRICS "Metrics must be all or a comma separated list of TotalWeight, LongestDistance, AverageDistance, ShortestDistance\n"
+
+#define UNKNOWN_NAME "No graph with that name\n"
+
 #define INVALID_NEW_EDGE "Must specify <from>,<to>,<weight> of the new edge\n"
 
 #define INVALID_EDGE "Must specify both endpoints of the edge to remove\n"
 
+#define INVALID_VERTEX "Vertices must be between 0 and the number of vertices - 1\n"
+
 #define ILLEGAL_COMMAND "unrecognized command "
 
 #define ENTER_COMMAND "Enter command:\n"
 
+#define COMMAND_TOO_LONG "Command too long, dropped\n"
+
 #define NEWLINE "\n"
 
 #define LINE_SEPERATOR "*****************************************************\n"
 using namespace std;
+
+// Which engine runs the metrics of an MST request
+enum ExecutionMode
+{
+    MODE_PIPELINE, // Active object pipeline
+    MODE_LF,       // Leader/Follower thread pool
+    MODE_INLINE,   // The pool worker that computed the tree, right after it
+    MODE_BOTH      // Pipeline and then the pool, each printing every metric
+};
+
+// Per connection state, kept in the Context: which graph the client works on
+struct Session
+{
+    string name;             // Registry name of the graph in use, empty for a private graph
+    shared_ptr<Graph> graph; // The private graph, unused while a named graph is in use
+    ExecutionMode mode = MODE_BOTH;
+    unsigned metrics = METRIC_ALL; // MetricFlags computed for each MST request
+};
+
+// Parse an engine name, returns false if it is not one
+bool parseMode(const char *name, ExecutionMode &mode)
+{
+    static const struct
+    {
+        const char *name;
+        ExecutionMode mode;
+    } modes[] = {{"pipeline", MODE_PIPELINE}, {"lf", MODE_LF}, {"inline", MODE_INLINE}, {"both", MODE_BOTH}};
+    for (const auto &entry : modes)
+    {
+        if (strcmp(name, entry.name) == 0)
+        {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a comma separated list of metric names, or "all", into MetricFlags. Returns 0 on error.
+unsigned parseMetrics(char *list)
+{
+    static const struct
+    {
+        const char *name;
+        unsigned flag;
+    } names[] = {{"TotalWeight", METRIC_TOTAL_WEIGHT},
+                 {"LongestDistance", METRIC_LONGEST_DISTANCE},
+                 {"AverageDistance", METRIC_AVERAGE_DISTANCE},
+                 {"ShortestDistance", METRIC_SHORTEST_DISTANCE},
+                 {"all", METRIC_ALL}};
+    unsigned metrics = 0;
+    char *saveptr;
+    for (char *name = strtok_r(list, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
+    {
+        unsigned flag = 0;
+        for (const auto &entry : names)
+        {
+            if (strcmp(name, entry.name) == 0)
+            {
+                flag = entry.flag;
+            }
+        }
+        if (flag == 0)
+        {
+            return 0;
+        }
+        metrics |= flag;
+    }
+    return metrics;
+}
+
+// Graph the session works on, held for the duration of one command
+shared_ptr<Graph> currentGraph(const Session &session)
+{
+    return session.name.empty() ? session.graph : GraphRegistry::getInstance().get(session.name);
+}
+
+// A private graph is only ever seen by its own connection and is edited in place,
+// a named one goes through the registry's copy-on-write
+bool editGraph(Session &session, const function<void(Graph &)> &change)
+{
+    if (!session.name.empty())
+    {
+        return GraphRegistry::getInstance().edit(session.name, change);
+    }
+    if (session.graph == nullptr)
+    {
+        return false;
+    }
+    change(*session.graph);
+    return true;
+}
+
+// Make a newly created graph the session's graph: registered under name if one is given,
+// private otherwise
+void useNewGraph(Session &session, Graph *created, const char *name)
+{
+    if (created != NULL && name != NULL)
+    {
+        GraphRegistry::getInstance().put(name, shared_ptr<Graph>(created));
+        session.name = name;
+    }
+    else
+    {
+        session.graph = shared_ptr<Graph>(created);
+    }
+}
+
 void printCommands(int fd)
 {
-    write(fd, COMMANDS_USAGE, sizeof(COMMANDS_USAGE));
+    Response out(fd);
+    out << COMMANDS_USAGE;
 }
 
 void getParameters(char **param1, char **param2, char **param3, char **saveptr)
@@ -56,125 +211,360 @@ void getParameters(char **param1, char **param2, char **param3, char **saveptr)
     }
 }
 
-Graph *getNewGraph(int fd, int vertices, int edges)
+// The limits come from graph_loader.hpp, so the message follows them when they change
+static void printInvalidGraphSize(Response &out)
+{
+    out << "Must have 0 to " << MAX_GRAPH_VERTICES << " vertices and 0 to " << MAX_BLOCK_EDGES << " edges\n";
+}
+
+// Parse a whole decimal number in [0, max], returns false if text is anything else
+static bool parseCount(const char *text, long max, int &value)
+{
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || parsed < 0 || parsed > max)
+    {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+// input[next..] holds what the client sent after the Newgraph line, possibly part of the edges
+Graph *getNewGraph(int fd, Response &out, int vertices, int edges, bool binary, string &input, size_t &next)
 {
     Graph *graph = new Graph(vertices);
     if (edges > 0)
     {
-        write(fd, PRINT_EDGES_MESSAGE, sizeof(PRINT_EDGES_MESSAGE));
-        for (int i = 0; i < edges; i++)
+        input.erase(0, next); // The readers take the already received bytes as their pending input
+        next = 0;
+        bool ok;
+        if (binary)
         {
-            char input[1024];
-            ssize_t bytesRead;
-            bytesRead = read(fd, input, sizeof(input) - 1);
-            if (bytesRead < 0)
-            {
-                perror("read");
-                exit(EXIT_FAILURE);
-            }
-            input[bytesRead] = '\0';
-
-            char *src, *dest, *weight, *saveptr;
-            src = strtok_r(input, ",\n", &saveptr);
-            dest = strtok_r(NULL, ",\n", &saveptr);
-            weight = strtok_r(NULL, ",\n", &saveptr);
-            if (src == NULL || dest == NULL || weight == NULL)
-            {
-                write(fd, INVALID_NEW_EDGE, sizeof(INVALID_NEW_EDGE));
-                delete graph;
-                graph = NULL;
-                break;
-            }
-            graph->addEdge(atoi(src), atoi(dest), atof(weight));
+            out << SEND_BINARY_EDGES_MESSAGE;
+            out.flush(true); // The client waits for the prompt before sending the block
+            ok = readBinaryEdges(fd, *graph, edges, input);
+        }
+        else
+        {
+            out << PRINT_EDGES_MESSAGE;
+            out.flush(true);
+            ok = readTextEdges(fd, *graph, edges, input);
+        }
+        if (!ok)
+        {
+            out << INVALID_EDGE_BLOCK;
+            delete graph;
+            graph = NULL;
         }
     }
     return graph;
 }
 
-void execute(int fd, char *token, Graph *graph)
+// Run the selected metrics of mst on the chosen engine and call done once the reply is complete
+void runMetrics(shared_ptr<Response> out, const string &token, shared_ptr<const MSTree> mst,
+                ExecutionMode mode, unsigned metrics, function<void()> done)
 {
-    MSTFactory factory;
-    unique_ptr<MSTStrategy> strategy;
-    MSTree mst;
+    if (mode == MODE_INLINE)
+    {
+        mst->printMetrics(*out, metrics);
+        *out << LINE_SEPERATOR;
+        done();
+        return;
+    }
+    auto runPool = [out, token, mst, metrics, done]()
+    {
+        *out << "Running Leader/Follower thread pool for " << token << '\n';
+        executeLeaderFollowerThreadPool(mst, out, metrics, [out, done]()
+                                        {
+            *out << LINE_SEPERATOR;
+            done(); });
+    };
+    if (mode == MODE_LF)
+    {
+        runPool();
+        return;
+    }
+    *out << "Running pipeline for " << token << '\n';
+    auto task = make_shared<PipelineTask>(mst, out, metrics);
+    task->setOnComplete([out, mode, runPool, done]()
+                        {
+        *out << LINE_SEPERATOR;
+        if (mode == MODE_BOTH)
+        {
+            runPool();
+        }
+        else
+        {
+            done();
+        } });
+    Pipeline::getPipeline().execute(task);
+}
+
+// Answer an MST request without blocking the calling I/O worker: the tree is computed on the pool
+// and the metrics engines post their results back. done is called once the reply is complete.
+// Returns false, without calling done, if token is not an MST algorithm.
+bool execute(shared_ptr<Response> out, const char *token, shared_ptr<const Graph> graph,
+             ExecutionMode mode, unsigned metrics, function<void()> done)
+{
+    MSTFactory::MSTType type;
     if (strcmp(token, "Prim") == 0)
     {
-        strategy = factory.getMSTStrategy(MSTFactory::PRIM);
+        type = MSTFactory::PRIM;
+    }
+    else if (strcmp(token, "Primheap") == 0)
+    {
+        type = MSTFactory::PRIM_HEAP;
     }
     else if (strcmp(token, "Kruskal") == 0)
     {
-        strategy = factory.getMSTStrategy(MSTFactory::KRUSKAL);
+        type = MSTFactory::KRUSKAL;
+    }
+    else if (strcmp(token, "Filterkruskal") == 0)
+    {
+        type = MSTFactory::FILTER_KRUSKAL;
+    }
+    else if (strcmp(token, "Parallelkruskal") == 0)
+    {
+        type = MSTFactory::PARALLEL_KRUSKAL;
+    }
+    else if (strcmp(token, "Boruvka") == 0)
+    {
+        type = MSTFactory::BORUVKA;
+    }
+    else if (strcmp(token, "Dynamic") == 0)
+    {
+        type = MSTFactory::DYNAMIC;
     }
     else
     {
-        return;
+        return false;
     }
-    mst = strategy->computeMST(*graph);
-    mst.printMST(fd);
-    write(fd, LINE_SEPERATOR, sizeof(LINE_SEPERATOR));
-    ostringstream oss;
-    oss << "Running pipeline for " << token << endl;
-    string output = oss.str();
-    write(fd, output.c_str(), output.size());
-    Pipeline &pipeline = Pipeline::getPipeline();
-    auto task = make_shared<PipelineTask>(mst, fd);
-    pipeline.execute(task);
-    task->waitForCompletion();
-    write(fd, LINE_SEPERATOR, sizeof(LINE_SEPERATOR));
-    oss.str("");
-    oss.clear();
-    oss << "Running Leader/Follower thread pool for " << token << endl;
-    output = oss.str();
-    write(fd, output.c_str(), output.size());
-    executeLeaderFollowerThreadPool(mst, fd);
-    write(fd, LINE_SEPERATOR, sizeof(LINE_SEPERATOR));
+    out->flush(); // Replies of the commands before this one need not wait for it
+    uint64_t start = latencyNow();
+    done = [start, done]()
+    {
+        done();
+        recordLatency(PHASE_REQUEST, start);
+    };
+    string name = token;
+    submitToLeaderFollowerThreadPool([=]()
+                                     {
+        MSTFactory factory;
+        unique_ptr<MSTStrategy> strategy = factory.getMSTStrategy(type);
+        // The tree is built once per graph version and then only shared, never copied, by every
+        // client reading that version, the pipeline and the pool
+        shared_ptr<const MSTree> mst = graph->getMST(type, *strategy, metrics);
+        mst->printMST(*out);
+        *out << LINE_SEPERATOR;
+        runMetrics(out, name, move(mst), mode, metrics, done); });
+    return true;
 }
 
 void freeContext(void *context)
 {
     if (context != NULL && context != INVALID_POINTER)
     {
-        printf("freeContext: deleting graph\n");
-        Graph *graph = (Graph *)(context);
-        delete graph;
+        printf("freeContext: deleting session\n");
+        Session *session = (Session *)(context);
+        delete session;
     }
 }
-void executeCommand(int fd, char *input, void **context)
+// Returns true if the command completes asynchronously: finish is then called once its reply is
+// complete, and until then neither the context nor input may be touched
+bool executeCommand(int fd, char *command, void **context, const shared_ptr<Response> &reply, string &input,
+                    size_t &next, const function<void()> &finish)
 {
+    Response &out = *reply;
     char *param1 = NULL, *param2 = NULL, *param3 = NULL, *saveptr;
 
-    char *token = strtok_r(input, " \n", &saveptr);
-    Graph *graph = (Graph *)(*context);
+    char *token = strtok_r(command, " \n", &saveptr);
+    if (*context == NULL)
+    {
+        *context = new Session();
+    }
+    Session &session = *(Session *)(*context);
+    shared_ptr<Graph> graph = currentGraph(session);
     if (token != NULL)
     {
-        if (strcmp(token, "Newgraph") == 0)
+        if (strcmp(token, "Newgraph") == 0 || strcmp(token, "Newgraphbin") == 0)
         {
-            if (graph != NULL)
+            session.name.clear();
+            session.graph = nullptr;
+            // An optional name comes before <verttices>,<edges>, which always holds a comma
+            char *name = NULL;
+            char *sizes = strtok_r(NULL, " \n", &saveptr);
+            if (sizes != NULL && strchr(sizes, ',') == NULL)
+            {
+                name = sizes;
+                sizes = strtok_r(NULL, " \n", &saveptr);
+            }
+            if (sizes != NULL)
             {
-                delete graph;
-                graph = NULL;
+                param1 = strtok_r(sizes, ",", &saveptr);
+                param2 = strtok_r(NULL, ",", &saveptr);
             }
-            getParameters(&param1, &param2, NULL, &saveptr);
+            int vertices, edges;
             if (param1 == NULL || param2 == NULL)
             {
-                write(fd, MISSING_VERT_EDGE, sizeof(MISSING_VERT_EDGE));
+                out << MISSING_VERT_EDGE;
+            }
+            else if (!parseCount(param1, MAX_GRAPH_VERTICES, vertices) || !parseCount(param2, MAX_BLOCK_EDGES, edges))
+            {
+                printInvalidGraphSize(out); // Before any prompt, so the client never sends the block
+            }
+            else
+            {
+                Graph *created = getNewGraph(fd, out, vertices, edges, strcmp(token, "Newgraphbin") == 0, input, next);
+                useNewGraph(session, created, name);
+            }
+        }
+        else if (strcmp(token, "Loadgraph") == 0)
+        {
+            // An optional name comes before the path
+            char *name = strtok_r(NULL, " \n", &saveptr);
+            char *path = strtok_r(NULL, " \n", &saveptr);
+            if (path == NULL)
+            {
+                path = name;
+                name = NULL;
+            }
+            string resolved;
+            if (path == NULL)
+            {
+                out << MISSING_PATH;
+            }
+            else if (!resolveGraphPath(path, resolved))
+            {
+                out << INVALID_PATH;
             }
             else
             {
-                graph = getNewGraph(fd, atoi(param1), atoi(param2));
-                *context = graph;
+                Graph *loaded = loadGraph(resolved.c_str());
+                if (loaded == NULL)
+                {
+                    out << INVALID_GRAPH_FILE;
+                }
+                else
+                {
+                    session.name.clear();
+                    session.graph = nullptr;
+                    useNewGraph(session, loaded, name);
+                }
             }
         }
-        else if (strcmp(token, "Prim") == 0 || strcmp(token, "Kruskal") == 0)
+        else if (strcmp(token, "Savegraph") == 0)
+        {
+            char *path = strtok_r(NULL, " \n", &saveptr);
+            string resolved;
+            if (graph == NULL)
+            {
+                out << MISSING_GRAPH;
+            }
+            else if (path == NULL)
+            {
+                out << MISSING_PATH;
+            }
+            else if (!resolveGraphPath(path, resolved))
+            {
+                out << INVALID_PATH;
+            }
+            else if (!saveGraph(*graph, resolved.c_str()))
+            {
+                out << SAVE_FAILED;
+            }
+        }
+        else if (strcmp(token, "Use") == 0)
+        {
+            char *name = strtok_r(NULL, " \n", &saveptr);
+            if (name == NULL)
+            {
+                out << MISSING_NAME;
+            }
+            else if (GraphRegistry::getInstance().get(name) == nullptr)
+            {
+                out << UNKNOWN_NAME;
+            }
+            else
+            {
+                session.name = name;
+                session.graph = nullptr;
+            }
+        }
+        else if (strcmp(token, "Drop") == 0)
+        {
+            char *name = strtok_r(NULL, " \n", &saveptr);
+            if (name == NULL)
+            {
+                out << MISSING_NAME;
+            }
+            else if (!GraphRegistry::getInstance().drop(name))
+            {
+                out << UNKNOWN_NAME;
+            }
+        }
+        else if (strcmp(token, "Mode") == 0)
+        {
+            char *engine = strtok_r(NULL, " \n", &saveptr);
+            if (engine == NULL || !parseMode(engine, session.mode))
+            {
+                out << INVALID_MODE;
+            }
+        }
+        else if (strcmp(token, "Metrics") == 0)
+        {
+            char *list = strtok_r(NULL, " \n", &saveptr);
+            unsigned metrics = list != NULL ? parseMetrics(list) : 0;
+            if (metrics == 0)
+            {
+                out << INVALID_METRICS;
+            }
+            else
+            {
+                session.metrics = metrics;
+            }
+        }
+        else if (strcmp(token, "Stats") == 0)
+        {
+            MSTCacheStats &stats = Graph::cacheStats();
+            out << "MSTCacheHits: " << stats.hits.load() << '\n';
+            out << "MSTCacheMisses: " << stats.misses.load() << '\n';
+            if (graph != NULL)
+            {
+                out << "GraphVersion: " << graph->getVersion() << '\n';
+            }
+            printLatencyStats(out);
+        }
+        else if (strcmp(token, "Prim") == 0 || strcmp(token, "Primheap") == 0 || strcmp(token, "Kruskal") == 0 || strcmp(token, "Filterkruskal") == 0 ||
+                 strcmp(token, "Parallelkruskal") == 0 || strcmp(token, "Boruvka") == 0 ||
+                 strcmp(token, "Dynamic") == 0)
         {
             printf("%s....\n", token);
             if (graph != NULL)
             {
-                execute(fd, token, graph);
-                // graph->printGraph(fd);
+                // An optional engine name overrides the session mode for this request
+                ExecutionMode mode = session.mode;
+                char *engine = strtok_r(NULL, " \n", &saveptr);
+                if (engine != NULL && !parseMode(engine, mode))
+                {
+                    out << INVALID_MODE;
+                }
+                else
+                {
+                    // The request may complete, and the next command start, before execute returns
+                    input.erase(0, next);
+                    next = 0;
+                    if (execute(reply, token, graph, mode, session.metrics, finish))
+                    {
+                        return true;
+                    }
+                }
+                // graph->printGraph(out);
             }
             else
             {
-                write(fd, MISSING_GRAPH, sizeof(MISSING_GRAPH));
+                out << MISSING_GRAPH;
             }
         }
         else if (strcmp(token, "Print") == 0)
@@ -182,11 +572,11 @@ void executeCommand(int fd, char *input, void **context)
             printf("Print....\n");
             if (graph != NULL)
             {
-                graph->printGraph(fd);
+                graph->printGraph(out);
             }
             else
             {
-                write(fd, MISSING_GRAPH, sizeof(MISSING_GRAPH));
+                out << MISSING_GRAPH;
             }
         }
         else if (strcmp(token, "Newedge") == 0)
@@ -198,17 +588,27 @@ void executeCommand(int fd, char *input, void **context)
 
                 if (param1 == NULL || param2 == NULL || param3 == NULL)
                 {
-                    write(fd, INVALID_NEW_EDGE, sizeof(INVALID_NEW_EDGE));
+                    out << INVALID_NEW_EDGE;
+                }
+                else if (!graph->hasVertex(atoi(param1)) || !graph->hasVertex(atoi(param2)))
+                {
+                    out << INVALID_VERTEX;
                 }
                 else
                 {
-
-                    graph->addEdge(atoi(param1), atoi(param2), atof(param3));
+                    int v1 = atoi(param1), v2 = atoi(param2);
+                    double weight = atof(param3);
+                    graph = nullptr; // Let go of this version so an unshared graph is edited in place
+                    if (!editGraph(session, [&](Graph &g)
+                                   { g.addEdge(v1, v2, weight); }))
+                    {
+                        out << MISSING_GRAPH;
+                    }
                 }
             }
             else
             {
-                write(fd, MISSING_GRAPH, sizeof(MISSING_GRAPH));
+                out << MISSING_GRAPH;
             }
         }
         else if (strcmp(token, "Removeedge") == 0)
@@ -220,27 +620,35 @@ void executeCommand(int fd, char *input, void **context)
 
                 if (param1 == NULL || param2 == NULL)
                 {
-                    write(fd, INVALID_EDGE, sizeof(INVALID_EDGE));
+                    out << INVALID_EDGE;
+                }
+                else if (!graph->hasVertex(atoi(param1)) || !graph->hasVertex(atoi(param2)))
+                {
+                    out << INVALID_VERTEX;
                 }
                 else
                 {
-
-                    graph->removeEdge(atoi(param1), atoi(param2));
+                    int v1 = atoi(param1), v2 = atoi(param2);
+                    graph = nullptr;
+                    if (!editGraph(session, [&](Graph &g)
+                                   { g.removeEdge(v1, v2); }))
+                    {
+                        out << MISSING_GRAPH;
+                    }
                 }
             }
             else
             {
-                write(fd, MISSING_GRAPH, sizeof(MISSING_GRAPH));
+                out << MISSING_GRAPH;
             }
         }
         else
         {
-            write(fd, ILLEGAL_COMMAND, sizeof(ILLEGAL_COMMAND));
-            write(fd, token, strlen(token));
-            write(fd, NEWLINE, sizeof(NEWLINE));
+            out << ILLEGAL_COMMAND << token << NEWLINE;
         }
     }
-    write(fd, ENTER_COMMAND, sizeof(ENTER_COMMAND));
+    out << ENTER_COMMAND;
+    return false;
 }
 
 void printCommandsToFd(int fd)
@@ -248,7 +656,39 @@ void printCommandsToFd(int fd)
     printCommands(fd);
 }
 
-void executeCommandToFd(int fd, char *command, void **context)
+bool executeCommandsToFd(int fd, string &input, void **context, const Response::Sink &sink,
+                         function<void(string)> resume)
 {
-    executeCommand(fd, command, context);
+    auto out = make_shared<Response>(sink); // The replies of every command run here go out together
+    // Completes the reply of an asynchronous command and lets the connection go on. This runs on
+    // a compute thread, so the reply is handed over instead of being written from here.
+    auto finish = [out, resume]()
+    {
+        *out << ENTER_COMMAND;
+        resume(out->release());
+    };
+    size_t next = 0;  // Start of the first byte not handled yet
+    size_t end;
+    while ((end = input.find('\n', next)) != string::npos)
+    {
+        string command(input, next, end - next);
+        next = end + 1;
+        if (!command.empty() && command.back() == '\r')
+        {
+            command.pop_back();
+        }
+        LatencyTimer timer(PHASE_PARSE);
+        if (executeCommand(fd, &command[0], context, out, input, next, finish))
+        {
+            return false; // The rest of input waits until resume() hands it back to a worker
+        }
+    }
+    input.erase(0, next);
+    if (input.size() > MAX_COMMAND_SIZE)
+    {
+        *out << COMMAND_TOO_LONG;
+        input.clear();
+    }
+    out->flush();
+    return true;
 }
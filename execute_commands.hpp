@@ -1,8 +1,20 @@
 #ifndef __EXECUTE_COMMANDS_H__
 #define __EXECUTE_COMMANDS_H__
 #define INVALID_POINTER reinterpret_cast<void*>(-1)
+// Longest command line kept while waiting for its newline
+#define MAX_COMMAND_SIZE (64 * 1024)
+
+#include <functional>
+#include <string>
+#include "response.hpp"
 
 void printCommandsToFd(int fd);
 void freeContext(void *context);
-void executeCommandToFd(int fd, char *command, void **context);
+// Run every complete, newline terminated command in input and hand all their replies to sink in
+// one go, on the calling thread. The incomplete tail is left in input for the next call. Returns
+// false if a command went on asynchronously: the call then returns at once, and resume is called
+// with the rest of the reply once that command is done, on the thread that completed it, so that
+// the caller can write it and run the rest of input.
+bool executeCommandsToFd(int fd, std::string &input, void **context, const Response::Sink &sink,
+                         std::function<void(std::string)> resume);
 #endif // __EXECUTE_COMMANDS_H__
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "graph_file.hpp"
+#include "graph_loader.hpp"
+#include <climits>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static_assert(sizeof(Edge) == 16 && offsetof(Edge, v2_) == 4 && offsetof(Edge, weight_) == 8,
+              "the graph file stores Edge records as they are laid out in memory");
+static_assert(sizeof(GraphFileHeader) % alignof(Edge) == 0, "the edge array must stay aligned");
+
+bool saveGraph(const Graph &graph, const char *path)
+{
+    string tmpPath = string(path) + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (file == NULL)
+    {
+        perror("fopen");
+        return false;
+    }
+    GraphFileHeader header = {};
+    memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+    header.version = GRAPH_FILE_VERSION;
+    header.edgeSize = sizeof(Edge);
+    header.numVertices = graph.numVertices_;
+    header.numEdges = graph.numEdges();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // Removed slots are left out, copying the live runs between them in one write each
+    EdgeSpan edges = graph.edges();
+    size_t first = 0;
+    for (size_t slot = 0; ok && slot <= edges.size(); ++slot)
+    {
+        if (slot == edges.size() || edges[slot].isRemoved())
+        {
+            ok = fwrite(edges.begin() + first, sizeof(Edge), slot - first, file) == slot - first;
+            first = slot + 1;
+        }
+    }
+    if (fclose(file) != 0 || !ok || rename(tmpPath.c_str(), path) != 0)
+    {
+        perror("saveGraph");
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+Graph *loadGraph(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(GraphFileHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (base == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    shared_ptr<const void> mapping(base, [length](const void *p)
+                                   { munmap(const_cast<void *>(p), length); });
+
+    const GraphFileHeader *header = static_cast<const GraphFileHeader *>(base);
+    if (memcmp(header->magic, GRAPH_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GRAPH_FILE_VERSION || header->edgeSize != sizeof(Edge) ||
+        header->numVertices <= 0 || header->numVertices > MAX_GRAPH_VERTICES ||
+        header->numEdges != (length - sizeof(GraphFileHeader)) / sizeof(Edge) ||
+        (length - sizeof(GraphFileHeader)) % sizeof(Edge) != 0)
+    {
+        fprintf(stderr, "loadGraph: %s is not a graph file of version %d\n", path, GRAPH_FILE_VERSION);
+        return NULL;
+    }
+    // The edge array shares the ownership of the whole mapping
+    const Edge *edges = reinterpret_cast<const Edge *>(static_cast<const char *>(base) + sizeof(GraphFileHeader));
+    // The file may come from anywhere: every endpoint is checked once here, so that the adjacency,
+    // union-find and dynamic forest can index by them
+    for (uint64_t i = 0; i < header->numEdges; ++i)
+    {
+        if (edges[i].v1_ < 0 || edges[i].v1_ >= header->numVertices || edges[i].v2_ < 0 ||
+            edges[i].v2_ >= header->numVertices)
+        {
+            fprintf(stderr, "loadGraph: %s has an edge outside its %lld vertices\n", path,
+                    (long long)header->numVertices);
+            return NULL;
+        }
+    }
+    return new Graph(header->numVertices, shared_ptr<const Edge>(mapping, edges), header->numEdges);
+}
+
+static string &graphDataDir()
+{
+    static string dir = GRAPH_DATA_DIR;
+    return dir;
+}
+
+void setGraphDataDir(const string &dir)
+{
+    graphDataDir() = dir;
+    if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST)
+    {
+        perror("mkdir");
+    }
+}
+
+bool resolveGraphPath(const char *path, string &resolved)
+{
+    if (path[0] == '\0' || path[0] == '/')
+    {
+        return false;
+    }
+    for (const char *component = path; component != NULL;)
+    {
+        const char *slash = strchr(component, '/');
+        size_t length = slash != NULL ? (size_t)(slash - component) : strlen(component);
+        if (length == 2 && component[0] == '.' && component[1] == '.')
+        {
+            return false;
+        }
+        component = slash != NULL ? slash + 1 : NULL;
+    }
+    resolved = graphDataDir() + "/" + path;
+    return true;
+}
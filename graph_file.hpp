@@ -0,0 +1,43 @@
+#ifndef GRAPH_FILE_HPP
+#define GRAPH_FILE_HPP
+
+#include "Graph.hpp"
+#include <cstdint>
+#include <string>
+
+// On-disk graph format, version GRAPH_FILE_VERSION: a GraphFileHeader followed by numEdges
+// Edge records laid out exactly as in memory, in the host byte order, so that a mapped file is
+// used as the edge array of a graph without any parsing.
+#define GRAPH_FILE_MAGIC "MSTGRAPH"
+#define GRAPH_FILE_VERSION 1
+
+// Directory the graph files named by clients live in, unless the server is given another one
+#define GRAPH_DATA_DIR "graphs"
+
+struct GraphFileHeader
+{
+    char magic[8];     // GRAPH_FILE_MAGIC, without the terminating zero
+    uint32_t version;  // GRAPH_FILE_VERSION
+    uint32_t edgeSize; // sizeof(Edge) of the writer
+    int64_t numVertices;
+    uint64_t numEdges;
+};
+
+// Writes the live edges of graph to path. The file is written next to path and then renamed
+// over it, so a graph still mapped from the old file keeps reading the old contents.
+// Returns false on error.
+bool saveGraph(const Graph &graph, const char *path);
+
+// Maps a file written by saveGraph read-only and returns a graph reading its edges in place,
+// or nullptr if the file cannot be mapped, is not a graph file of this version, or has an edge
+// endpoint outside its vertices. Checking the endpoints reads the whole file once, O(E).
+Graph *loadGraph(const char *path);
+
+// Set the directory client paths are resolved in and create it if needed. Called once at startup.
+void setGraphDataDir(const std::string &dir);
+
+// Resolve a path sent by a client under the data directory. Returns false for an absolute path
+// or one with a ".." component, so clients can only reach files inside the directory.
+bool resolveGraphPath(const char *path, std::string &resolved);
+
+#endif // GRAPH_FILE_HPP
@@ -0,0 +1,82 @@
+#include "graph_generators.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+Graph *randomGraph(int vertices, long long edges, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<double> weight(1.0, 1000.0);
+    Graph *graph = new Graph(vertices);
+    graph->edges_.reserve(edges);
+    for (int v = 1; v < vertices; ++v)
+    {
+        graph->addEdge(uniform_int_distribution<int>(0, v - 1)(rng), v, weight(rng));
+    }
+    uniform_int_distribution<int> vertex(0, vertices - 1);
+    for (long long e = vertices - 1; e < edges; ++e)
+    {
+        graph->addEdge(vertex(rng), vertex(rng), weight(rng));
+    }
+    return graph;
+}
+
+Graph *powerLawGraph(int vertices, int links, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<double> weight(1.0, 1000.0);
+    Graph *graph = new Graph(vertices);
+    graph->edges_.reserve((size_t)vertices * links);
+    vector<int> endpoints; // Every vertex appears once per incident edge
+    endpoints.push_back(0);
+    for (int v = 1; v < vertices; ++v)
+    {
+        for (int l = 0; l < links && l < v; ++l)
+        {
+            int u = endpoints[uniform_int_distribution<size_t>(0, endpoints.size() - 1)(rng)];
+            graph->addEdge(u, v, weight(rng));
+            endpoints.push_back(u);
+            endpoints.push_back(v);
+        }
+    }
+    return graph;
+}
+
+Graph *gridGraph(int vertices, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<double> weight(1.0, 1000.0);
+    Graph *graph = new Graph(vertices);
+    int columns = max(1, (int)sqrt((double)vertices));
+    graph->edges_.reserve(2 * (size_t)vertices);
+    for (int v = 0; v < vertices; ++v)
+    {
+        if ((v + 1) % columns != 0 && v + 1 < vertices)
+        {
+            graph->addEdge(v, v + 1, weight(rng));
+        }
+        if (v + columns < vertices)
+        {
+            graph->addEdge(v, v + columns, weight(rng));
+        }
+    }
+    return graph;
+}
+
+Graph *completeGraph(int vertices, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<double> weight(1.0, 1000.0);
+    Graph *graph = new Graph(vertices);
+    graph->edges_.reserve((size_t)vertices * (vertices - 1) / 2);
+    for (int u = 0; u < vertices; ++u)
+    {
+        for (int v = u + 1; v < vertices; ++v)
+        {
+            graph->addEdge(u, v, weight(rng));
+        }
+    }
+    return graph;
+}
@@ -0,0 +1,22 @@
+#ifndef GRAPH_GENERATORS_HPP
+#define GRAPH_GENERATORS_HPP
+
+#include "Graph.hpp"
+
+// Seeded synthetic graphs for the benchmarks: the same arguments always give the same graph.
+// Weights are uniform in [1, 1000). The caller owns the returned graph.
+
+// Random connected graph: a random spanning tree plus (edges - vertices + 1) random extra edges
+Graph *randomGraph(int vertices, long long edges, unsigned seed);
+
+// Power-law graph by preferential attachment: every new vertex links to `links` earlier vertices
+// picked in proportion to their degree, so a few hubs end up with most of the edges
+Graph *powerLawGraph(int vertices, int links, unsigned seed);
+
+// Nearly square grid: vertex v is linked to its right and lower neighbours, about 2V edges
+Graph *gridGraph(int vertices, unsigned seed);
+
+// Complete graph, V(V - 1) / 2 edges
+Graph *completeGraph(int vertices, unsigned seed);
+
+#endif // GRAPH_GENERATORS_HPP
@@ -0,0 +1,154 @@
+#include "graph_loader.hpp"
+#include <cerrno>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Read once into buf, retrying on EINTR. Returns the byte count, 0 on EOF and -1 on error.
+static ssize_t readChunk(int fd, char *buf, size_t size)
+{
+    ssize_t n;
+    do
+    {
+        n = read(fd, buf, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+static const char *skipSeparators(const char *p, const char *end)
+{
+    while (p < end && (*p == '\n' || *p == '\r' || *p == ' '))
+        ++p;
+    return p;
+}
+
+// Parse one "<from>,<to>,<weight>" line in [p, lineEnd). Returns false if it is malformed.
+static bool parseEdge(const char *p, const char *lineEnd, int &from, int &to, double &weight)
+{
+    auto r1 = from_chars(p, lineEnd, from);
+    if (r1.ec != errc() || r1.ptr == lineEnd || *r1.ptr != ',')
+        return false;
+    auto r2 = from_chars(r1.ptr + 1, lineEnd, to);
+    if (r2.ec != errc() || r2.ptr == lineEnd || *r2.ptr != ',')
+        return false;
+    auto r3 = from_chars(r2.ptr + 1, lineEnd, weight);
+    if (r3.ec != errc())
+        return false;
+    const char *rest = r3.ptr;
+    while (rest < lineEnd && (*rest == ' ' || *rest == '\r'))
+        ++rest;
+    return rest == lineEnd;
+}
+
+// Reserve room for the edges that can be in the bytes at hand plus one chunk, at most `edges`.
+// The vector grows from there, so a client announcing a huge block cannot allocate it up front.
+static void reserveEdges(Graph &graph, int edges, size_t bytes, size_t minEdgeBytes)
+{
+    size_t fit = (bytes + EDGE_CHUNK_SIZE) / minEdgeBytes;
+    graph.edges_.reserve(graph.edges_.size() + min<size_t>(edges, fit));
+}
+
+bool readTextEdges(int fd, Graph &graph, int edges, string &pending)
+{
+    reserveEdges(graph, edges, pending.size(), sizeof("0,0,0\n") - 1);
+    // Start from the bytes that were already received, then keep reading chunks
+    vector<char> buf(max<size_t>(EDGE_CHUNK_SIZE, pending.size() + EDGE_CHUNK_SIZE));
+    size_t filled = pending.size(); // Bytes not parsed yet, always at the start of buf
+    memcpy(buf.data(), pending.data(), filled);
+    pending.clear();
+    int parsed = 0;
+    bool eof = false;
+    while (true)
+    {
+        const char *p = buf.data();
+        const char *end = buf.data() + filled;
+        while (parsed < edges)
+        {
+            p = skipSeparators(p, end);
+            const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (lineEnd == NULL)
+            {
+                if (!eof || p == end)
+                    break;
+                lineEnd = end; // The last line may come without a newline
+            }
+            int from, to;
+            double weight;
+            if (!parseEdge(p, lineEnd, from, to, weight) || !graph.hasVertex(from) || !graph.hasVertex(to))
+            {
+                return false;
+            }
+            graph.edges_.emplace_back(from, to, weight);
+            ++parsed;
+            p = lineEnd < end ? lineEnd + 1 : end;
+        }
+        filled = end - p;
+        memmove(buf.data(), p, filled);
+        if (parsed == edges)
+        {
+            pending.assign(buf.data(), filled); // Whatever came after the block
+            return true;
+        }
+        if (eof || filled == buf.size())
+        {
+            return false; // The peer stopped early, or one line is longer than the whole buffer
+        }
+        ssize_t n = readChunk(fd, buf.data() + filled, buf.size() - filled);
+        if (n < 0)
+        {
+            perror("read");
+            return false;
+        }
+        eof = n == 0;
+        filled += n;
+    }
+}
+
+bool readBinaryEdges(int fd, Graph &graph, int edges, string &pending)
+{
+    reserveEdges(graph, edges, pending.size(), sizeof(BinaryEdge));
+    size_t remaining = (size_t)edges * sizeof(BinaryEdge);
+    // Start from the bytes that were already received
+    size_t taken = min(remaining, pending.size());
+    vector<char> buf(max<size_t>(EDGE_CHUNK_SIZE, taken));
+    memcpy(buf.data(), pending.data(), taken);
+    pending.erase(0, taken);
+    remaining -= taken;
+    size_t filled = taken; // Bytes not turned into edges yet, always at the start of buf
+    bool valid = true;     // A bad record still lets the rest of the block be read, not taken as commands
+    while (true)
+    {
+        size_t records = filled / sizeof(BinaryEdge);
+        for (size_t i = 0; i < records; ++i)
+        {
+            BinaryEdge record;
+            memcpy(&record, buf.data() + i * sizeof(BinaryEdge), sizeof(record));
+            valid = valid && graph.hasVertex(record.from) && graph.hasVertex(record.to);
+            if (valid)
+            {
+                graph.edges_.emplace_back(record.from, record.to, record.weight);
+            }
+        }
+        filled -= records * sizeof(BinaryEdge);
+        memmove(buf.data(), buf.data() + records * sizeof(BinaryEdge), filled);
+        if (remaining == 0)
+        {
+            return valid;
+        }
+        // Never read past the block, the next command may follow it
+        ssize_t n = readChunk(fd, buf.data() + filled, min(buf.size() - filled, remaining));
+        if (n <= 0)
+        {
+            if (n < 0)
+                perror("read");
+            return false;
+        }
+        remaining -= n;
+        filled += n;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef GRAPH_LOADER_HPP
+#define GRAPH_LOADER_HPP
+
+#include "Graph.hpp"
+#include <cstdint>
+#include <string>
+
+// Size of the chunks the edge block is read in
+#define EDGE_CHUNK_SIZE (64 * 1024)
+
+// Largest sizes a Newgraph or Newgraphbin command may announce
+#define MAX_GRAPH_VERTICES (1 << 26)
+#define MAX_BLOCK_EDGES (1 << 27)
+
+// One edge of a binary edge block, in the host byte order
+struct BinaryEdge
+{
+    int32_t from;
+    int32_t to;
+    double weight;
+};
+
+// Both readers first consume `pending`, the bytes already received from the client, and read
+// the rest from fd. On success `pending` holds what came after the block.
+// Edges go straight into edges_, so they are meant for a graph that was just created. The edge
+// count comes from the client, so storage grows with the bytes that actually arrive.
+
+// Reads exactly `edges` edges given as "<from>,<to>,<weight>" lines, in large chunks, and
+// appends them to the graph. Lines may be split across reads or several may arrive in one.
+// Returns false on a malformed line, an endpoint that is not a vertex of the graph, or if the
+// peer stops before the last edge.
+bool readTextEdges(int fd, Graph &graph, int edges, std::string &pending);
+
+// Reads exactly `edges` BinaryEdge records (edges * sizeof(BinaryEdge) bytes) and appends them
+// to the graph. Returns false on an endpoint that is not a vertex of the graph or if the peer
+// stops before the last record.
+bool readBinaryEdges(int fd, Graph &graph, int edges, std::string &pending);
+
+#endif // GRAPH_LOADER_HPP
@@ -0,0 +1,45 @@
+#include "graph_registry.hpp"
+
+using namespace std;
+
+GraphRegistry &GraphRegistry::getInstance()
+{
+    static GraphRegistry instance;
+    return instance;
+}
+
+void GraphRegistry::put(const string &name, shared_ptr<Graph> graph)
+{
+    lock_guard<mutex> lock(mutex_);
+    graphs_[name] = move(graph);
+}
+
+shared_ptr<Graph> GraphRegistry::get(const string &name)
+{
+    lock_guard<mutex> lock(mutex_);
+    auto it = graphs_.find(name);
+    return it == graphs_.end() ? nullptr : it->second;
+}
+
+bool GraphRegistry::drop(const string &name)
+{
+    lock_guard<mutex> lock(mutex_);
+    return graphs_.erase(name) > 0;
+}
+
+bool GraphRegistry::edit(const string &name, const function<void(Graph &)> &change)
+{
+    lock_guard<mutex> lock(mutex_);
+    auto it = graphs_.find(name);
+    if (it == graphs_.end())
+    {
+        return false;
+    }
+    // References are only handed out under the lock, so a count of one cannot grow meanwhile
+    if (it->second.use_count() > 1)
+    {
+        it->second = make_shared<Graph>(*it->second);
+    }
+    change(*it->second);
+    return true;
+}
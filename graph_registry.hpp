@@ -0,0 +1,39 @@
+#ifndef GRAPH_REGISTRY_HPP
+#define GRAPH_REGISTRY_HPP
+
+#include "Graph.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Server wide table of named graphs, shared by every connection.
+// Readers take a reference to the current version and keep it alive while they use it, so a
+// graph is stored once however many clients read it. Edits are copy-on-write: a version that
+// someone is still reading is never changed, the edit goes to a copy that replaces it.
+class GraphRegistry
+{
+public:
+    static GraphRegistry &getInstance();
+
+    // Add or replace the graph stored under name
+    void put(const std::string &name, std::shared_ptr<Graph> graph);
+    // Current version of the graph, nullptr if there is no graph with that name
+    std::shared_ptr<Graph> get(const std::string &name);
+    // Forget the name; readers still holding the graph keep it until they are done
+    bool drop(const std::string &name);
+    // Apply change to the graph, in place when nobody else holds it and on a copy otherwise.
+    // Returns false if there is no graph with that name.
+    bool edit(const std::string &name, const std::function<void(Graph &)> &change);
+
+private:
+    GraphRegistry() = default;
+    GraphRegistry(const GraphRegistry &) = delete;
+    GraphRegistry &operator=(const GraphRegistry &) = delete;
+
+    std::mutex mutex_; // Guards graphs_
+    std::unordered_map<std::string, std::shared_ptr<Graph>> graphs_;
+};
+
+#endif // GRAPH_REGISTRY_HPP
@@ -0,0 +1,127 @@
+#include "latency_stats.hpp"
+#include "response.hpp"
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+    "parse",
+    "request",
+    "computeMST",
+    "PLTotalWeight",
+    "PLLongestDistance",
+    "PLAverageDistance",
+    "PLShortestDistance",
+    "PLJoin",
+    "LFTPTotalWeight",
+    "LFTPLongestDistance",
+    "LFTPAverageDistance",
+    "LFTPShortestDistance",
+    "LFTPJob",
+    "TaskQueueWait",
+    "PoolQueueWait",
+    "write",
+};
+
+// Values below 2^SUB_BUCKET_BITS get a bucket each. Above that, a value whose top bit is bit b
+// keeps its top SUB_BUCKET_BITS bits: shifted right by s = b - SUB_BUCKET_BITS + 1, it falls in
+// the upper half of the sub-bucket range, which the offset s * half stacks after the lower ranges.
+size_t LatencyHistogram::bucketOf(uint64_t ns)
+{
+    const uint64_t half = 1ULL << (SUB_BUCKET_BITS - 1);
+    ns = min<uint64_t>(ns, (1ULL << MAX_VALUE_BITS) - 1);
+    if (ns < (1ULL << SUB_BUCKET_BITS))
+    {
+        return ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - SUB_BUCKET_BITS + 1;
+    return shift * half + (ns >> shift);
+}
+
+uint64_t LatencyHistogram::bucketLimit(size_t bucket)
+{
+    const uint64_t half = 1ULL << (SUB_BUCKET_BITS - 1);
+    if (bucket < (1ULL << SUB_BUCKET_BITS))
+    {
+        return bucket;
+    }
+    int shift = bucket / half - 1;
+    return ((bucket - shift * half + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    counts_[bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+    uint64_t seen = max_.load(memory_order_relaxed);
+    while (ns > seen && !max_.compare_exchange_weak(seen, ns, memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t total = 0;
+    for (const auto &count : counts_)
+    {
+        total += count.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    // Writers keep going while this runs, so the result is for a slightly blurred snapshot
+    uint64_t total = count();
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, ceil(p * total));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+    {
+        seen += counts_[bucket].load(memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return min(bucketLimit(bucket), max());
+        }
+    }
+    return max();
+}
+
+uint64_t latencyNow()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyHistogram &latencyHistogram(LatencyPhase phase)
+{
+    static LatencyHistogram histograms[PHASE_COUNT];
+    return histograms[phase];
+}
+
+void recordLatency(LatencyPhase phase, uint64_t start)
+{
+    latencyHistogram(phase).record(latencyNow() - start);
+}
+
+atomic<uint64_t> &bytesWritten()
+{
+    static atomic<uint64_t> bytes{0};
+    return bytes;
+}
+
+void printLatencyStats(Response &out)
+{
+    out << "BytesWritten: " << (size_t)bytesWritten().load(memory_order_relaxed) << '\n';
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        const LatencyHistogram &histogram = latencyHistogram((LatencyPhase)phase);
+        out << PHASE_NAMES[phase] << ": count " << (size_t)histogram.count()
+            << " p50 " << histogram.percentile(0.5) / 1000.0
+            << "us p99 " << histogram.percentile(0.99) / 1000.0
+            << "us p999 " << histogram.percentile(0.999) / 1000.0
+            << "us max " << histogram.max() / 1000.0 << "us\n";
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class Response;
+
+// Phases whose latency is recorded, in the order the Stats command prints them
+enum LatencyPhase
+{
+    PHASE_PARSE,                  // One command line, until its reply is ready or the request is handed off
+    PHASE_REQUEST,                // MST request, from hand-off to complete reply
+    PHASE_COMPUTE_MST,            // MSTStrategy::computeMST on an MST cache miss
+    PHASE_PL_TOTAL_WEIGHT,
+    PHASE_PL_LONGEST_DISTANCE,
+    PHASE_PL_AVERAGE_DISTANCE,
+    PHASE_PL_SHORTEST_DISTANCE,
+    PHASE_PL_JOIN,
+    PHASE_LFTP_TOTAL_WEIGHT,
+    PHASE_LFTP_LONGEST_DISTANCE,
+    PHASE_LFTP_AVERAGE_DISTANCE,
+    PHASE_LFTP_SHORTEST_DISTANCE,
+    PHASE_LFTP_JOB,
+    PHASE_PIPELINE_QUEUE_WAIT,    // Time a task spends in a TaskQueue before its stage takes it
+    PHASE_POOL_QUEUE_WAIT,        // Time a task spends in a LeaderFollowerThreadPool deque
+    PHASE_WRITE,                  // One Response::flush to a client
+    PHASE_COUNT
+};
+
+// Lock-free log-linear histogram of nanosecond values, HDR style: every power of two is split
+// into 32 linear sub-buckets, so any recorded value is known to within about 3%. Recording is
+// a couple of relaxed atomic adds, cheap enough to leave on all the time.
+class LatencyHistogram
+{
+public:
+    void record(uint64_t ns);
+    uint64_t count() const;
+    // Smallest bucket bound that at least fraction p of the recorded values do not exceed
+    uint64_t percentile(double p) const;
+    uint64_t max() const
+    {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr int MAX_VALUE_BITS = 40; // About 18 minutes, longer values are clamped
+    static constexpr size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) << (SUB_BUCKET_BITS - 1);
+    static size_t bucketOf(uint64_t ns);
+    static uint64_t bucketLimit(size_t bucket);
+
+    std::atomic<uint64_t> counts_[BUCKETS] = {};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Monotonic clock in nanoseconds, for the start times passed to recordLatency
+uint64_t latencyNow();
+// Records the time elapsed since start, taken from latencyNow(), as one sample of phase
+void recordLatency(LatencyPhase phase, uint64_t start);
+LatencyHistogram &latencyHistogram(LatencyPhase phase);
+// Server wide count of the bytes sent to clients
+std::atomic<uint64_t> &bytesWritten();
+// One line per phase with its sample count, p50, p99, p999 and maximum in microseconds
+void printLatencyStats(Response &out);
+
+// Records the lifetime of the timer as one sample of phase
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyPhase phase) : phase_(phase), start_(latencyNow()) {}
+    ~LatencyTimer()
+    {
+        recordLatency(phase_, start_);
+    }
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+
+private:
+    LatencyPhase phase_;
+    uint64_t start_;
+};
+
+#endif // LATENCY_STATS_HPP
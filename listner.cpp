@@ -56,7 +56,7 @@ int createListner(const char *port)
     }
 
     // Listen
-    if (listen(listener, 10) == -1)
+    if (listen(listener, SOMAXCONN) == -1)
     {
         return -1;
     }
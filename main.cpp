@@ -6,6 +6,7 @@
 #include <thread>
 #include <atomic>
 #include "pollserver.hpp"
+#include "graph_file.hpp"
 using namespace std;
 
 #define PORT "9034"
@@ -13,8 +14,11 @@ void runPollServer(const char* port, std::atomic<bool>& exit_flag) {
     poll_clients(port, exit_flag);
 }
 
-int main()
+// Usage: mst_project [data-dir], where Loadgraph and Savegraph paths are resolved (GRAPH_DATA_DIR)
+int main(int argc, char *argv[])
 {
+    setGraphDataDir(argc > 1 ? argv[1] : GRAPH_DATA_DIR);
+
     // Create an atomic flag for signaling exit
     atomic<bool> exit_flag(false);
 
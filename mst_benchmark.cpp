@@ -0,0 +1,229 @@
+#include "Graph.hpp"
+#include "MSTStrategy.hpp"
+#include "MSTree.hpp"
+#include "graph_file.hpp"
+#include "graph_generators.hpp"
+#include "graph_loader.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+// Average milliseconds of one random Newedge/Removeedge followed by an MST query
+double timeEdits(MSTStrategy &strategy, Graph &graph, int edits, unsigned seed, double &totalWeight)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<int> vertex(0, graph.numVertices_ - 1);
+    uniform_real_distribution<double> weight(1.0, 1000.0);
+    strategy.computeMST(graph); // Not timed: lets the dynamic forest get built
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < edits; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            graph.addEdge(vertex(rng), vertex(rng), weight(rng));
+        }
+        else
+        {
+            size_t slot;
+            do
+            {
+                slot = uniform_int_distribution<size_t>(0, graph.edges().size() - 1)(rng);
+            } while (graph.edges()[slot].isRemoved());
+            Edge edge = graph.edges()[slot];
+            graph.removeEdge(edge.v1_, edge.v2_);
+        }
+        totalWeight = strategy.computeMST(graph).getTotalWeight();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count() / edits;
+}
+
+// Average nanoseconds of one Removeedge, taking out `removals` random edges of a copy of graph
+double timeRemovals(const Graph &graph, int removals, unsigned seed)
+{
+    Graph copy(graph);
+    mt19937 rng(seed);
+    vector<Edge> victims;
+    for (int i = 0; i < removals; ++i)
+    {
+        victims.push_back(graph.edges()[uniform_int_distribution<size_t>(0, graph.edges().size() - 1)(rng)]);
+    }
+    copy.removeEdge(victims[0].v1_, victims[0].v2_); // Not timed: builds the edge index
+    auto start = chrono::steady_clock::now();
+    for (int i = 1; i < removals; ++i)
+    {
+        copy.removeEdge(victims[i].v1_, victims[i].v2_);
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / (removals - 1);
+}
+
+// Edges/sec the Newgraph and Newgraphbin loaders must sustain over a local socket
+#define INGEST_TARGET_EDGES_PER_SEC 5e6
+
+// Edges per second of loading `block` through a socket pair, as a client uploading it would
+double timeIngest(const string &block, int edges, bool binary, Graph &loaded)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    auto start = chrono::steady_clock::now();
+    thread client([&]()
+                  {
+                      size_t sent = 0;
+                      while (sent < block.size())
+                      {
+                          ssize_t n = write(fds[1], block.data() + sent, block.size() - sent);
+                          if (n <= 0)
+                              break;
+                          sent += n;
+                      }
+                      close(fds[1]); });
+    string pending;
+    bool ok = binary ? readBinaryEdges(fds[0], loaded, edges, pending) : readTextEdges(fds[0], loaded, edges, pending);
+    auto end = chrono::steady_clock::now();
+    client.join();
+    close(fds[0]);
+    if (!ok)
+    {
+        printf("ingest failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return edges / chrono::duration<double>(end - start).count();
+}
+
+// Time one MST computation in milliseconds
+double timeMST(MSTStrategy &strategy, const Graph &graph, double &totalWeight)
+{
+    auto start = chrono::steady_clock::now();
+    MSTree mst = strategy.computeMST(graph);
+    auto end = chrono::steady_clock::now();
+    totalWeight = mst.getTotalWeight();
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int vertices = argc > 1 ? atoi(argv[1]) : 1000000;
+    long long edges = argc > 2 ? atoll(argv[2]) : 10000000;
+    unsigned seed = argc > 3 ? atoi(argv[3]) : 1;
+    int edits = argc > 4 ? atoi(argv[4]) : 20;
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+
+    Graph *graph = randomGraph(vertices, edges, seed);
+    printf("vertices=%d edges=%zu seed=%u\n", vertices, graph->numEdges(), seed);
+
+    double weight;
+    KruskalMST kruskal;
+    double kruskalMs = timeMST(kruskal, *graph, weight);
+    printf("%-10s %8s %12s %10s %16s\n", "algorithm", "threads", "time_ms", "speedup", "total_weight");
+    printf("%-10s %8d %12.2f %10.2f %16.3f\n", "Kruskal", 1, kruskalMs, 1.0, weight);
+
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        BoruvkaMST boruvka(threads);
+        double ms = timeMST(boruvka, *graph, weight);
+        printf("%-10s %8u %12.2f %10.2f %16.3f\n", "Boruvka", threads, ms, kruskalMs / ms, weight);
+    }
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        ParallelKruskalMST parallelKruskal(threads);
+        double ms = timeMST(parallelKruskal, *graph, weight);
+        printf("%-10s %8u %12.2f %10.2f %16.3f\n", "ParKruskal", threads, ms, kruskalMs / ms, weight);
+    }
+
+    // Comparison sort against filter-Kruskal with radix-sorted partitions
+    printf("\n%-14s %12s %12s %16s\n", "kruskal", "edges", "time_ms", "total_weight");
+    Graph *powerLaw = powerLawGraph(vertices, max(1LL, edges / vertices), seed);
+    for (Graph *g : {graph, powerLaw})
+    {
+        const char *shape = g == graph ? "random" : "power-law";
+        FilterKruskalMST filterKruskal;
+        double ms = timeMST(kruskal, *g, weight);
+        printf("%-14s %12zu %12.2f %16.3f  %s\n", "Kruskal", g->numEdges(), ms, weight, shape);
+        ms = timeMST(filterKruskal, *g, weight);
+        printf("%-14s %12zu %12.2f %16.3f  %s\n", "Filterkruskal", g->numEdges(), ms, weight, shape);
+    }
+    delete powerLaw;
+
+    // Prim with the std::set queue against the indexed heap, on this graph and on a dense one.
+    // The set version keeps integer weights, so its total may differ slightly.
+    printf("\n%-10s %12s %12s %16s\n", "prim", "edges", "time_ms", "total_weight");
+    int denseVertices = 3000;
+    Graph *dense = randomGraph(denseVertices, (long long)denseVertices * (denseVertices - 1) / 2, seed);
+    for (Graph *g : {graph, dense})
+    {
+        PrimMST prim;
+        HeapPrimMST heapPrim;
+        double ms = timeMST(prim, *g, weight);
+        printf("%-10s %12zu %12.2f %16.3f\n", "Prim", g->numEdges(), ms, weight);
+        ms = timeMST(heapPrim, *g, weight);
+        printf("%-10s %12zu %12.2f %16.3f\n", "Primheap", g->numEdges(), ms, weight);
+    }
+    delete dense;
+
+    // Edit+query latency: the same edit sequence, applied to two copies of the graph
+    printf("\n%-10s %8s %16s %16s\n", "algorithm", "edits", "ms_per_edit", "total_weight");
+    Graph *recomputed = randomGraph(vertices, edges, seed);
+    double recomputeMs = timeEdits(kruskal, *recomputed, edits, seed + 1, weight);
+    printf("%-10s %8d %16.3f %16.3f\n", "Kruskal", edits, recomputeMs, weight);
+    DynamicMST dynamic;
+    double dynamicMs = timeEdits(dynamic, *graph, edits, seed + 1, weight);
+    printf("%-10s %8d %16.3f %16.3f\n", "Dynamic", edits, dynamicMs, weight);
+
+    // Removeedge alone, without an MST query after it
+    int removals = 100000;
+    printf("\n%-10s %8s %16s\n", "remove", "edges", "ns_per_remove");
+    printf("%-10s %8d %16.1f\n", "Removeedge", removals, timeRemovals(*recomputed, removals, seed + 2));
+
+    // Edge block ingestion throughput, text and binary
+    string text, binary;
+    for (const auto &edge : graph->edges())
+    {
+        if (edge.isRemoved())
+            continue;
+        text += to_string(edge.v1_) + "," + to_string(edge.v2_) + "," + to_string(edge.weight_) + "\n";
+        BinaryEdge record = {edge.v1_, edge.v2_, edge.weight_};
+        binary.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+    printf("\n%-10s %12s %16s %10s\n", "ingest", "edges", "edges_per_sec", "target");
+    for (bool isBinary : {false, true})
+    {
+        Graph loaded(vertices);
+        double rate = timeIngest(isBinary ? binary : text, graph->numEdges(), isBinary, loaded);
+        printf("%-10s %12zu %16.0f %10s\n", isBinary ? "binary" : "text", loaded.numEdges(), rate,
+               rate >= INGEST_TARGET_EDGES_PER_SEC ? "met" : "MISSED");
+    }
+
+    // Savegraph, then Loadgraph and a first query straight from the mapped file
+    string path = "/tmp/mst_benchmark_" + to_string(getpid()) + ".graph";
+    auto start = chrono::steady_clock::now();
+    bool saved = saveGraph(*graph, path.c_str());
+    double saveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    Graph *mapped = saved ? loadGraph(path.c_str()) : nullptr;
+    double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if (mapped == nullptr)
+    {
+        printf("graph file round trip failed\n");
+        exit(EXIT_FAILURE);
+    }
+    double mappedKruskalMs = timeMST(kruskal, *mapped, weight);
+    printf("\n%-10s %12s %12s %12s %16s\n", "file", "edges", "save_ms", "load_ms", "kruskal_ms");
+    printf("%-10s %12zu %12.2f %12.3f %16.2f\n", "mapped", mapped->numEdges(), saveMs, loadMs, mappedKruskalMs);
+    delete mapped;
+    unlink(path.c_str());
+
+    delete recomputed;
+    delete graph;
+    return 0;
+}
@@ -0,0 +1,369 @@
+#include "latency_stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <netdb.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+// Closed-loop load generator for the MST server. Every connection replays a JSONL command script
+// in order: it sends one command, reads the reply up to the "Enter command:" prompt that ends it,
+// and only then sends the next one, no sooner than the target rate allows. Latencies are kept
+// per command label in the same histograms the server uses for its Stats command.
+//
+// One script line is one JSON object: {"command": "<text>", "label": "<name>"}. The command text
+// may span lines, such as a Newgraph followed by its edges, and the label defaults to its first
+// word. Every connection works on its own graph, so scripts usually start with a Newgraph.
+
+#define LOADGEN_USAGE                                                                             \
+    "usage: mst_loadgen --script <file.jsonl> [--host H] [--port P] [--connections N]\n"          \
+    "                   [--rate commands/sec, 0 = unthrottled] [--iterations N | --duration S]\n" \
+    "                   [--wait S, retry connecting while the server starts]\n"
+
+// The server greets a new connection with the command list, which ends with this line
+#define GREETING_END "enter command:\n"
+// Every reply ends with this line
+#define REPLY_END "Enter command:\n"
+
+struct ScriptCommand
+{
+    string label;
+    string text; // Sent as is, ends with a newline
+    size_t histogram;
+};
+
+struct LoadgenOptions
+{
+    string host = "127.0.0.1";
+    string port = "9034";
+    string script;
+    int connections = 4;
+    double rate = 0;       // Commands per second over all connections
+    int iterations = 1;    // Script passes per connection, unless duration is set
+    double duration = 0;   // Seconds
+    double wait = 0;       // Seconds to keep retrying a refused connection
+};
+
+// Parse the JSON string starting at the opening quote at p, leaving p after the closing quote
+static bool parseJsonString(const char *&p, string &out)
+{
+    if (*p++ != '"')
+        return false;
+    out.clear();
+    while (*p != '"')
+    {
+        if (*p == '\0')
+            return false;
+        if (*p != '\\')
+        {
+            out += *p++;
+            continue;
+        }
+        ++p;
+        switch (*p++)
+        {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'u':
+        {
+            // Only the ASCII range ever shows up in command scripts
+            unsigned code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *p++;
+                if (!isxdigit((unsigned char)c))
+                    return false;
+                code = code * 16 + (isdigit((unsigned char)c) ? c - '0' : tolower(c) - 'a' + 10);
+            }
+            if (code > 0x7f)
+                return false;
+            out += (char)code;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    ++p;
+    return true;
+}
+
+static void skipSpaces(const char *&p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        ++p;
+}
+
+// Read the "command" and "label" members of one flat JSON object, ignoring any other scalar member
+static bool parseScriptLine(const string &line, ScriptCommand &command)
+{
+    const char *p = line.c_str();
+    skipSpaces(p);
+    if (*p++ != '{')
+        return false;
+    command.text.clear();
+    command.label.clear();
+    skipSpaces(p);
+    while (*p != '}')
+    {
+        string key, value;
+        skipSpaces(p);
+        if (!parseJsonString(p, key))
+            return false;
+        skipSpaces(p);
+        if (*p++ != ':')
+            return false;
+        skipSpaces(p);
+        if (*p == '"')
+        {
+            if (!parseJsonString(p, value))
+                return false;
+        }
+        else
+        {
+            while (*p != ',' && *p != '}' && *p != '\0' && *p != '{' && *p != '[')
+                ++p;
+            if (*p == '\0' || *p == '{' || *p == '[')
+                return false;
+        }
+        if (key == "command")
+            command.text = value;
+        else if (key == "label")
+            command.label = value;
+        skipSpaces(p);
+        if (*p == ',')
+            ++p;
+        else if (*p != '}')
+            return false;
+    }
+    if (command.text.empty())
+        return false;
+    if (command.text.back() != '\n')
+        command.text += '\n';
+    if (command.label.empty())
+        command.label = command.text.substr(0, command.text.find_first_of(" \r\n"));
+    return true;
+}
+
+static int connectOnce(const LoadgenOptions &options)
+{
+    struct addrinfo hints = {}, *ai, *p;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rv = getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &ai);
+    if (rv != 0)
+    {
+        fprintf(stderr, "mst_loadgen: %s\n", gai_strerror(rv));
+        return -1;
+    }
+    int fd = -1;
+    for (p = ai; p != NULL; p = p->ai_next)
+    {
+        fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (fd == -1)
+            continue;
+        if (connect(fd, p->ai_addr, p->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+// Connect to the server, retrying for options.wait seconds so a script can start the server
+// and the load generator together
+static int connectTo(const LoadgenOptions &options)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::nanoseconds((long long)(options.wait * 1e9));
+    int fd;
+    while ((fd = connectOnce(options)) == -1 && chrono::steady_clock::now() < deadline)
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    return fd;
+}
+
+// Read until the received text ends with end. Returns false if the server goes away first.
+static bool readReply(int fd, string &buf, const char *end)
+{
+    size_t endLength = strlen(end);
+    buf.clear();
+    char chunk[64 * 1024];
+    while (buf.size() < endLength || buf.compare(buf.size() - endLength, endLength, end) != 0)
+    {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buf.append(chunk, n);
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const string &text)
+{
+    size_t sent = 0;
+    while (sent < text.size())
+    {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+static bool parseOptions(int argc, char *argv[], LoadgenOptions &options)
+{
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            return false;
+        const char *name = argv[i], *value = argv[i + 1];
+        if (strcmp(name, "--script") == 0)
+            options.script = value;
+        else if (strcmp(name, "--host") == 0)
+            options.host = value;
+        else if (strcmp(name, "--port") == 0)
+            options.port = value;
+        else if (strcmp(name, "--connections") == 0)
+            options.connections = atoi(value);
+        else if (strcmp(name, "--rate") == 0)
+            options.rate = atof(value);
+        else if (strcmp(name, "--iterations") == 0)
+            options.iterations = atoi(value);
+        else if (strcmp(name, "--duration") == 0)
+            options.duration = atof(value);
+        else if (strcmp(name, "--wait") == 0)
+            options.wait = atof(value);
+        else
+            return false;
+    }
+    return !options.script.empty() && options.connections > 0 && options.rate >= 0 && options.iterations > 0 &&
+           options.duration >= 0 && options.wait >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    LoadgenOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, LOADGEN_USAGE);
+        return EXIT_FAILURE;
+    }
+
+    ifstream file(options.script);
+    if (!file)
+    {
+        perror(options.script.c_str());
+        return EXIT_FAILURE;
+    }
+    vector<ScriptCommand> script;
+    vector<string> labels;
+    map<string, size_t> labelIndex;
+    string line;
+    for (int number = 1; getline(file, line); ++number)
+    {
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        ScriptCommand command;
+        if (!parseScriptLine(line, command))
+        {
+            fprintf(stderr, "%s:%d: expected {\"command\": \"...\"}\n", options.script.c_str(), number);
+            return EXIT_FAILURE;
+        }
+        auto inserted = labelIndex.emplace(command.label, labels.size());
+        if (inserted.second)
+            labels.push_back(command.label);
+        command.histogram = inserted.first->second;
+        script.push_back(command);
+    }
+    if (script.empty())
+    {
+        fprintf(stderr, "%s: no commands\n", options.script.c_str());
+        return EXIT_FAILURE;
+    }
+
+    vector<unique_ptr<LatencyHistogram>> histograms;
+    for (size_t i = 0; i < labels.size(); ++i)
+        histograms.push_back(make_unique<LatencyHistogram>());
+    atomic<uint64_t> completed{0}, errors{0};
+
+    // Every connection sends at rate / connections, at fixed points in time from the start
+    auto interval = chrono::nanoseconds(options.rate > 0 ? (long long)(1e9 * options.connections / options.rate) : 0);
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::nanoseconds((long long)(options.duration * 1e9));
+    vector<thread> clients;
+    for (int c = 0; c < options.connections; ++c)
+    {
+        clients.emplace_back([&, c]()
+                             {
+            int fd = connectTo(options);
+            string reply;
+            if (fd == -1 || !readReply(fd, reply, GREETING_END))
+            {
+                fprintf(stderr, "mst_loadgen: connection %d could not reach %s:%s\n", c, options.host.c_str(),
+                        options.port.c_str());
+                errors++;
+                if (fd != -1)
+                    close(fd);
+                return;
+            }
+            // Spread the first sends over one interval so the connections do not move in lockstep
+            auto next = start + interval * c / options.connections;
+            for (int pass = 0; options.duration > 0 || pass < options.iterations; ++pass)
+            {
+                for (const ScriptCommand &command : script)
+                {
+                    if (options.duration > 0 && chrono::steady_clock::now() >= deadline)
+                    {
+                        close(fd);
+                        return;
+                    }
+                    this_thread::sleep_until(next);
+                    next = max(next + interval, chrono::steady_clock::now() - interval);
+                    uint64_t sentAt = latencyNow();
+                    if (!sendAll(fd, command.text) || !readReply(fd, reply, REPLY_END))
+                    {
+                        fprintf(stderr, "mst_loadgen: connection %d lost during %s\n", c, command.label.c_str());
+                        errors++;
+                        close(fd);
+                        return;
+                    }
+                    histograms[command.histogram]->record(latencyNow() - sentAt);
+                    completed++;
+                }
+            }
+            close(fd); });
+    }
+    for (auto &client : clients)
+        client.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("connections=%d commands=%llu errors=%llu elapsed_s=%.3f throughput_rps=%.1f\n", options.connections,
+           (unsigned long long)completed.load(), (unsigned long long)errors.load(), elapsed,
+           completed.load() / elapsed);
+    printf("%-20s %10s %12s %12s %12s %12s\n", "command", "count", "p50_us", "p99_us", "p999_us", "max_us");
+    for (size_t i = 0; i < labels.size(); ++i)
+    {
+        const LatencyHistogram &histogram = *histograms[i];
+        printf("%-20s %10llu %12.1f %12.1f %12.1f %12.1f\n", labels[i].c_str(),
+               (unsigned long long)histogram.count(), histogram.percentile(0.5) / 1000.0,
+               histogram.percentile(0.99) / 1000.0, histogram.percentile(0.999) / 1000.0, histogram.max() / 1000.0);
+    }
+    return errors.load() == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+#include "Graph.hpp"
+#include "MSTStrategy.hpp"
+#include "MSTree.hpp"
+#include "graph_generators.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Reproducible MST benchmark suite: builds seeded synthetic graphs, times every selected
+// strategy and every MSTree metric with warmup runs and repetitions, and prints one CSV or JSON
+// record per measurement so that runs can be diffed and tracked over time.
+
+#define SUITE_USAGE                                                                                \
+    "usage: mst_suite [--vertices V] [--edges E] [--complete-vertices V] [--seed S]\n"            \
+    "                 [--warmup N] [--reps N] [--format csv|json]\n"                               \
+    "                 [--graphs random,grid,powerlaw,complete]\n"                                  \
+    "                 [--strategies prim,primheap,kruskal,filterkruskal,parallelkruskal,boruvka]\n"
+
+struct SuiteOptions
+{
+    int vertices = 100000;
+    long long edges = 1000000;
+    int completeVertices = 2000; // The complete graph has V(V - 1) / 2 edges, so it gets its own V
+    unsigned seed = 1;
+    int warmup = 1;
+    int reps = 5;
+    bool json = false;
+    string graphs = "random,grid,powerlaw,complete";
+    string strategies = "prim,primheap,kruskal,filterkruskal,parallelkruskal,boruvka";
+};
+
+struct Measurement
+{
+    string graph;
+    int vertices;
+    size_t edges;
+    const char *kind; // "strategy" or "metric"
+    string name;
+    vector<double> ms; // One entry per repetition
+    double result;     // Total weight of the tree, or the value of the metric
+};
+
+static bool listed(const string &list, const string &name)
+{
+    return ("," + list + ",").find("," + name + ",") != string::npos;
+}
+
+// Run fn warmup times untimed, then reps times timed. Returns the last result.
+static double repeat(const SuiteOptions &options, const function<double()> &fn, vector<double> &ms)
+{
+    double result = 0;
+    for (int i = 0; i < options.warmup; ++i)
+    {
+        result = fn();
+    }
+    for (int i = 0; i < options.reps; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        result = fn();
+        ms.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return result;
+}
+
+static void printMeasurement(const SuiteOptions &options, const Measurement &m, bool first)
+{
+    vector<double> sorted = m.ms;
+    sort(sorted.begin(), sorted.end());
+    double mean = 0;
+    for (double ms : sorted)
+    {
+        mean += ms / sorted.size();
+    }
+    double median = sorted.size() % 2 ? sorted[sorted.size() / 2]
+                                      : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+    if (options.json)
+    {
+        printf("%s  {\"graph\": \"%s\", \"vertices\": %d, \"edges\": %zu, \"seed\": %u, \"kind\": \"%s\", "
+               "\"name\": \"%s\", \"reps\": %zu, \"min_ms\": %.4f, \"median_ms\": %.4f, \"mean_ms\": %.4f, "
+               "\"result\": %.6f}",
+               first ? "" : ",\n", m.graph.c_str(), m.vertices, m.edges, options.seed, m.kind, m.name.c_str(),
+               sorted.size(), sorted.front(), median, mean, m.result);
+    }
+    else
+    {
+        printf("%s,%d,%zu,%u,%s,%s,%zu,%.4f,%.4f,%.4f,%.6f\n", m.graph.c_str(), m.vertices, m.edges, options.seed,
+               m.kind, m.name.c_str(), sorted.size(), sorted.front(), median, mean, m.result);
+    }
+    fflush(stdout);
+}
+
+static bool parseOptions(int argc, char *argv[], SuiteOptions &options)
+{
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char *name = argv[i], *value = argv[i + 1];
+        if (strcmp(name, "--vertices") == 0)
+            options.vertices = atoi(value);
+        else if (strcmp(name, "--edges") == 0)
+            options.edges = atoll(value);
+        else if (strcmp(name, "--complete-vertices") == 0)
+            options.completeVertices = atoi(value);
+        else if (strcmp(name, "--seed") == 0)
+            options.seed = atoi(value);
+        else if (strcmp(name, "--warmup") == 0)
+            options.warmup = atoi(value);
+        else if (strcmp(name, "--reps") == 0)
+            options.reps = atoi(value);
+        else if (strcmp(name, "--format") == 0 && (strcmp(value, "csv") == 0 || strcmp(value, "json") == 0))
+            options.json = strcmp(value, "json") == 0;
+        else if (strcmp(name, "--graphs") == 0)
+            options.graphs = value;
+        else if (strcmp(name, "--strategies") == 0)
+            options.strategies = value;
+        else
+            return false;
+    }
+    return options.vertices > 1 && options.completeVertices > 1 && options.reps > 0 && options.warmup >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    SuiteOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, SUITE_USAGE);
+        return EXIT_FAILURE;
+    }
+
+    static const struct
+    {
+        const char *name;
+        MSTFactory::MSTType type;
+    } strategies[] = {{"prim", MSTFactory::PRIM},
+                      {"primheap", MSTFactory::PRIM_HEAP},
+                      {"kruskal", MSTFactory::KRUSKAL},
+                      {"filterkruskal", MSTFactory::FILTER_KRUSKAL},
+                      {"parallelkruskal", MSTFactory::PARALLEL_KRUSKAL},
+                      {"boruvka", MSTFactory::BORUVKA}};
+    static const struct
+    {
+        const char *name;
+        double (MSTree::*find)() const;
+    } metrics[] = {{"TotalWeight", &MSTree::getTotalWeight},
+                   {"LongestDistance", &MSTree::findLongestDistance},
+                   {"AverageDistance", &MSTree::findAverageDistance},
+                   {"ShortestDistance", &MSTree::findShortestDistance}};
+    const struct
+    {
+        const char *name;
+        function<Graph *()> build;
+    } graphs[] = {{"random", [&]()
+                   { return randomGraph(options.vertices, options.edges, options.seed); }},
+                  {"grid", [&]()
+                   { return gridGraph(options.vertices, options.seed); }},
+                  {"powerlaw", [&]()
+                   { return powerLawGraph(options.vertices, max(1LL, options.edges / options.vertices), options.seed); }},
+                  {"complete", [&]()
+                   { return completeGraph(options.completeVertices, options.seed); }}};
+
+    if (options.json)
+        printf("[\n");
+    else
+        printf("graph,vertices,edges,seed,kind,name,reps,min_ms,median_ms,mean_ms,result\n");
+    bool first = true;
+    MSTFactory factory;
+    for (const auto &generator : graphs)
+    {
+        if (!listed(options.graphs, generator.name))
+            continue;
+        Graph *graph = generator.build();
+        Measurement base = {generator.name, graph->numVertices_, graph->numEdges(), "strategy", "", {}, 0};
+        for (const auto &entry : strategies)
+        {
+            if (!listed(options.strategies, entry.name))
+                continue;
+            unique_ptr<MSTStrategy> strategy = factory.getMSTStrategy(entry.type);
+            Measurement m = base;
+            m.name = entry.name;
+            m.result = repeat(options, [&]()
+                              { return strategy->computeMST(*graph).getTotalWeight(); }, m.ms);
+            printMeasurement(options, m, first);
+            first = false;
+        }
+
+        // Metrics are timed on a tree that has none of them cached
+        KruskalMST kruskal;
+        MSTree tree = kruskal.computeMST(*graph);
+        for (const auto &metric : metrics)
+        {
+            Measurement m = base;
+            m.kind = "metric";
+            m.name = metric.name;
+            m.result = repeat(options, [&]()
+                              { return (tree.*metric.find)(); }, m.ms);
+            printMeasurement(options, m, first);
+            first = false;
+        }
+        delete graph;
+    }
+    if (options.json)
+        printf("\n]\n");
+    return 0;
+}
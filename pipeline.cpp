@@ -1,20 +1,34 @@
-#include <unistd.h>
 #include "pipeline.hpp"
+#include <algorithm>
 
 // PipelineTask class implementation
-PipelineTask::PipelineTask(MSTree data, int fd) : data_(data), done_(false), fd_(fd)
+PipelineTask::PipelineTask(std::shared_ptr<const MSTree> data, std::shared_ptr<Response> output, unsigned metrics)
+    : data_(std::move(data)), done_(false), output_(std::move(output)), metrics_(metrics)
 {
     remaining_stages_ = 0;
 }
 
-MSTree &PipelineTask::getData()
+const MSTree &PipelineTask::getData() const
 {
-    return data_;
+    return *data_;
 }
 
-void PipelineTask::setData(MSTree data)
+void PipelineTask::setData(std::shared_ptr<const MSTree> data)
 {
-    data_ = data;
+    data_ = std::move(data);
+}
+
+void PipelineTask::setDependencies(const std::vector<int> &dependency_counts)
+{
+    pending_dependencies_ = dependency_counts;
+    results_.clear();
+    results_.resize(dependency_counts.size());
+}
+
+bool PipelineTask::dependencyCompleted(int stage)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return --pending_dependencies_[stage] == 0;
 }
 
 void PipelineTask::waitForCompletion()
@@ -26,54 +40,226 @@ void PipelineTask::waitForCompletion()
 
 void PipelineTask::stageCompleted()
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    remaining_stages_--; // Decrement the counter
-    if (remaining_stages_ == 0)
+    std::function<void()> on_complete;
     {
+        std::unique_lock<std::mutex> lock(mutex_);
+        remaining_stages_--; // Decrement the counter
+        if (remaining_stages_ != 0)
+        {
+            return;
+        }
         done_ = true;       // All stages have completed
         cond_.notify_one(); // Notify that task processing is complete
+        on_complete.swap(on_complete_); // Also drops the callback's references once it ran
+    }
+    if (on_complete)
+    {
+        on_complete();
     }
 }
 
 // TaskQueue class implementation
+#define PIPELINE_QUEUE_CAPACITY 64 // Tasks per ring before the producer has to wait
+#define PIPELINE_SPIN_ROUNDS 128   // Polls with a pause in between before yielding
+#define PIPELINE_YIELD_ROUNDS 16   // Polls with a yield in between before parking
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Poll ready() while spinning, then while yielding, and finally park on cond until it holds.
+// parked counts the sleepers so that wake() only takes park_mutex when someone is asleep.
+template <typename Ready>
+static void spinThenPark(std::mutex &park_mutex, std::condition_variable &cond, std::atomic<int> &parked, Ready ready)
+{
+    for (int round = 0; round < PIPELINE_SPIN_ROUNDS + PIPELINE_YIELD_ROUNDS; ++round)
+    {
+        if (ready())
+        {
+            return;
+        }
+        if (round < PIPELINE_SPIN_ROUNDS)
+        {
+            cpuRelax();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked.fetch_add(1);
+    // Pairs with the fence in wake(): either ready() sees the progress or wake() sees the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cond.wait(lock, ready);
+    parked.fetch_sub(1);
+}
+
+// Called after making progress that a sleeper on cond may be waiting for
+static void wake(std::mutex &park_mutex, std::condition_variable &cond, std::atomic<int> &parked)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(park_mutex); // The sleeper is either waiting or not parked yet
+        cond.notify_all();
+    }
+}
+
+TaskQueue::TaskQueue() : next_input_(0), consumers_(1)
+{
+    addProducer();
+    inputs_[0]->shared = true;
+}
+
+int TaskQueue::addProducer()
+{
+    inputs_.push_back(std::make_unique<Input>(PIPELINE_QUEUE_CAPACITY));
+    return inputs_.size() - 1;
+}
+
+void TaskQueue::setProducerCount(int input, int producers)
+{
+    inputs_[input]->shared = input == 0 || producers > 1;
+}
+
+void TaskQueue::setConsumerCount(int consumers)
+{
+    consumers_ = consumers;
+}
+
+bool TaskQueue::allEmpty() const
+{
+    for (const auto &input : inputs_)
+    {
+        if (!input->ring.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TaskQueue::push(Input &input, std::shared_ptr<PipelineTask> task)
+{
+    SpscRing<QueuedTask> &ring = input.ring;
+    QueuedTask item(std::move(task), latencyNow());
+    while (!ring.tryPush(item))
+    {
+        spinThenPark(park_mutex_, not_full_, producers_parked_, [&ring]()
+                     { return !ring.full(); });
+    }
+    wake(park_mutex_, not_empty_, consumers_parked_);
+}
+
+void TaskQueue::enqueue(int input, std::shared_ptr<PipelineTask> task)
+{
+    Input &target = *inputs_[input];
+    if (target.shared)
+    {
+        // Held while waiting for room: on input 0 this is the backpressure on Pipeline::execute
+        std::lock_guard<std::mutex> lock(target.producer_mutex);
+        push(target, std::move(task));
+    }
+    else
+    {
+        push(target, std::move(task));
+    }
+}
+
 void TaskQueue::enqueue(std::shared_ptr<PipelineTask> task)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    queue_.push(task);
-    cond_.notify_one(); // Notify the waiting thread
+    enqueue(0, std::move(task));
 }
 
 std::shared_ptr<PipelineTask> TaskQueue::dequeue()
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    cond_.wait(lock, [this]()
-               { return !queue_.empty(); });
-    auto task = queue_.front();
-    queue_.pop();
-    return task;
+    QueuedTask item;
+    for (;;)
+    {
+        bool closed = closed_.load(std::memory_order_acquire); // Read first, so what was queued before close is drained
+        {
+            std::unique_lock<std::mutex> lock(consumer_mutex_, std::defer_lock);
+            if (consumers_ > 1)
+            {
+                lock.lock();
+            }
+            for (size_t i = 0; i < inputs_.size(); ++i)
+            {
+                SpscRing<QueuedTask> &ring = inputs_[next_input_]->ring;
+                next_input_ = (next_input_ + 1) % inputs_.size();
+                if (ring.tryPop(item))
+                {
+                    lock = std::unique_lock<std::mutex>(); // Let the next replica in before the wake-up
+                    wake(park_mutex_, not_full_, producers_parked_);
+                    recordLatency(PHASE_PIPELINE_QUEUE_WAIT, item.second);
+                    return std::move(item.first);
+                }
+            }
+        }
+        if (closed)
+        {
+            return nullptr;
+        }
+        spinThenPark(park_mutex_, not_empty_, consumers_parked_, [this]()
+                     { return closed_.load(std::memory_order_acquire) || !allEmpty(); });
+    }
+}
+
+void TaskQueue::close()
+{
+    closed_.store(true, std::memory_order_release);
+    wake(park_mutex_, not_empty_, consumers_parked_);
 }
 
 // ActiveObject class implementation
-ActiveObject::ActiveObject(ActiveObject *next_stage) : done_(false), next_stage_(next_stage) {}
+ActiveObject::ActiveObject(ActiveObject *next_stage) : replicas_(1), index_(0), dependency_count_(0)
+{
+    if (next_stage)
+    {
+        addNextStage(next_stage);
+    }
+}
 
 ActiveObject::~ActiveObject()
 {
     stop();
 }
 
+void ActiveObject::setReplicas(int replicas)
+{
+    replicas_ = replicas > 0 ? replicas : (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
 void ActiveObject::start()
 {
-    thread_ = std::thread(&ActiveObject::run, this);
+    queue_.setConsumerCount(replicas_);
+    for (auto &next : next_stages_)
+    {
+        next.first->queue_.setProducerCount(next.second, replicas_);
+    }
+    for (int i = 0; i < replicas_; ++i)
+    {
+        threads_.emplace_back(&ActiveObject::run, this);
+    }
 }
 
 void ActiveObject::stop()
 {
-    done_ = true;
-    queue_.enqueue(nullptr); // Enqueue a null task to unblock the thread
-    if (thread_.joinable())
+    queue_.close(); // The threads exit once the tasks already queued are done
+    for (auto &thread : threads_)
     {
-        thread_.join();
+        if (thread.joinable())
+        {
+            thread.join();
+        }
     }
+    threads_.clear();
 }
 
 void ActiveObject::enqueueTask(std::shared_ptr<PipelineTask> task)
@@ -81,62 +267,129 @@ void ActiveObject::enqueueTask(std::shared_ptr<PipelineTask> task)
     queue_.enqueue(task);
 }
 
+void ActiveObject::enqueueTask(int input, std::shared_ptr<PipelineTask> task)
+{
+    queue_.enqueue(input, task);
+}
+
 void ActiveObject::run()
 {
-    while (!done_)
+    for (;;)
     {
         auto task = queue_.dequeue();
         if (task == nullptr)
-            break;              // Exit if a null task is received
-        processTask(task);      // Process the task in this stage
-        task->stageCompleted(); // Notify the task that this stage is done
+            break;              // Exit once stopped and drained
+        processTask(task); // Process the task in this stage
 
-        if (next_stage_)
+        for (auto &next : next_stages_)
         {
-            next_stage_->enqueueTask(task); // Pass task to the next stage
+            if (task->dependencyCompleted(next.first->getIndex()))
+            {
+                next.first->enqueueTask(next.second, task); // Pass task to a stage whose dependencies are all done
+            }
         }
+        task->stageCompleted(); // Notify the task that this stage is done
     }
 }
 void PLTotalWeight::processTask(std::shared_ptr<PipelineTask> task)
 {
-    std::ostringstream oss;
-    oss << "TotalWeight: " << task->getData().getTotalWeight() << std::endl;
-    std::string output = oss.str();
-    write(task->getFD(), output.c_str(), output.size());
+    LatencyTimer timer(PHASE_PL_TOTAL_WEIGHT);
+    if (task->wants(METRIC_TOTAL_WEIGHT))
+    {
+        task->getResult(getIndex()) << "TotalWeight: " << task->getData().getTotalWeight() << '\n';
+    }
 }
 
 void PLLongestDistance::processTask(std::shared_ptr<PipelineTask> task)
 {
-    std::ostringstream oss;
-    oss << "LongestDistance: " << task->getData().findLongestDistance() << std::endl;
-    std::string output = oss.str();
-    write(task->getFD(), output.c_str(), output.size());
+    LatencyTimer timer(PHASE_PL_LONGEST_DISTANCE);
+    if (task->wants(METRIC_LONGEST_DISTANCE))
+    {
+        task->getResult(getIndex()) << "LongestDistance: " << task->getData().findLongestDistance() << '\n';
+    }
 }
 
 void PLAverageDistance::processTask(std::shared_ptr<PipelineTask> task)
 {
-    std::ostringstream oss;
-    oss << "AverageDistance: " << task->getData().findAverageDistance() << std::endl;
-    std::string output = oss.str();
-    write(task->getFD(), output.c_str(), output.size());
+    LatencyTimer timer(PHASE_PL_AVERAGE_DISTANCE);
+    if (task->wants(METRIC_AVERAGE_DISTANCE))
+    {
+        task->getResult(getIndex()) << "AverageDistance: " << task->getData().findAverageDistance() << '\n';
+    }
 }
 
 void PLShortestDistance::processTask(std::shared_ptr<PipelineTask> task)
 {
-    std::ostringstream oss;
-    oss << "ShortestDistance: " << task->getData().findShortestDistance() << std::endl;
-    std::string output = oss.str();
-    write(task->getFD(), output.c_str(), output.size());
+    LatencyTimer timer(PHASE_PL_SHORTEST_DISTANCE);
+    if (task->wants(METRIC_SHORTEST_DISTANCE))
+    {
+        task->getResult(getIndex()) << "ShortestDistance: " << task->getData().findShortestDistance() << '\n';
+    }
+}
+
+void PLJoin::processTask(std::shared_ptr<PipelineTask> task)
+{
+    LatencyTimer timer(PHASE_PL_JOIN);
+    Response &output = task->getOutput();
+    for (const Response &result : task->getResults())
+    {
+        output << result;
+    }
 }
 
 // Pipeline class implementation
-Pipeline::Pipeline() = default;
+// Threads of each distance stage, 0 means std::thread::hardware_concurrency(). They walk the whole
+// tree, while the total weight and the join are cheap enough for a single thread.
+#define PIPELINE_DISTANCE_REPLICAS 0
+
+Pipeline::Pipeline(Mode mode)
+{
+    ActiveObject *totalWeight = new PLTotalWeight();
+    ActiveObject *longestDistance = new PLLongestDistance();
+    ActiveObject *averageDistance = new PLAverageDistance();
+    ActiveObject *shortestDistance = new PLShortestDistance();
+    longestDistance->setReplicas(PIPELINE_DISTANCE_REPLICAS);
+    averageDistance->setReplicas(PIPELINE_DISTANCE_REPLICAS);
+    shortestDistance->setReplicas(PIPELINE_DISTANCE_REPLICAS);
+    if (mode == SERIAL)
+    {
+        addStage(totalWeight);
+        addStage(longestDistance);
+        addStage(averageDistance);
+        addStage(shortestDistance);
+        addStage(new PLJoin());
+    }
+    else
+    {
+        // The metrics are independent of each other, only the join needs all of them
+        addStage(totalWeight, {});
+        addStage(longestDistance, {});
+        addStage(averageDistance, {});
+        addStage(shortestDistance, {});
+        addStage(new PLJoin(), {totalWeight, longestDistance, averageDistance, shortestDistance});
+    }
+    start(); // Start the pipeline stages
+}
 
 void Pipeline::addStage(ActiveObject *stage)
 {
-    if (!stages_.empty())
+    if (stages_.empty())
+    {
+        addStage(stage, {});
+    }
+    else
     {
-        stages_.back()->setNextStage(stage); // Link previous stage to this one
+        addStage(stage, {stages_.back()}); // Link previous stage to this one
+    }
+}
+
+void Pipeline::addStage(ActiveObject *stage, const std::vector<ActiveObject *> &depends_on)
+{
+    stage->setIndex(stages_.size());
+    stage->setDependencyCount(depends_on.size());
+    for (ActiveObject *dependency : depends_on)
+    {
+        dependency->addNextStage(stage);
     }
     stages_.push_back(stage);
 }
@@ -145,8 +398,20 @@ void Pipeline::execute(std::shared_ptr<PipelineTask> task)
 {
     if (!stages_.empty())
     {
+        std::vector<int> dependency_counts;
+        for (auto &stage : stages_)
+        {
+            dependency_counts.push_back(stage->getDependencyCount());
+        }
         task->setRemainingStages(getStageCount());
-        stages_[0]->enqueueTask(task); // Start the task in the first stage
+        task->setDependencies(dependency_counts);
+        for (auto &stage : stages_)
+        {
+            if (stage->getDependencyCount() == 0)
+            {
+                stage->enqueueTask(task); // Start the task in every stage without dependencies
+            }
+        }
     }
 }
 
@@ -171,20 +436,14 @@ int Pipeline::getStageCount() const
     return stages_.size();
 }
 
-Pipeline &Pipeline::getPipeline()
+Pipeline &Pipeline::getPipeline(Mode mode)
 {
-    static Pipeline instance; // Singleton instance of the pipeline
-    static bool initialized = false;
-
-    if (!initialized)
+    // Function local statics are initialized exactly once, even when several workers race here
+    if (mode == SERIAL)
     {
-        // Initialize the pipeline with stages
-        instance.addStage(new PLTotalWeight());
-        instance.addStage(new PLLongestDistance());
-        instance.addStage(new PLAverageDistance());
-        instance.addStage(new PLShortestDistance());
-        instance.start(); // Start the pipeline stages
-        initialized = true;
+        static Pipeline serial(SERIAL);
+        return serial;
     }
-    return instance;
+    static Pipeline fan_out(FAN_OUT);
+    return fan_out;
 }
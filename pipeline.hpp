@@ -9,28 +9,47 @@
 #include <memory>
 #include <vector>
 #include <atomic>
-#include <sstream>
+#include <functional>
 #include "MSTree.hpp"
+#include "response.hpp"
+#include "latency_stats.hpp"
+#include "spsc_ring.hpp"
 // PipelineTask class representing the data to be processed
 class PipelineTask
 {
 private:
-    MSTree data_;
+    std::shared_ptr<const MSTree> data_; // Immutable snapshot shared with every stage
     int remaining_stages_; // Counter tracking how many stages are left
     std::mutex mutex_;
     std::condition_variable cond_;
     bool done_; // PipelineTask completion flag
-    int fd_;
+    std::shared_ptr<Response> output_;      // Reply of the request, only the join stage writes it
+    unsigned metrics_;                      // MetricFlags the stages should produce
+    std::vector<int> pending_dependencies_; // Per stage: dependencies that have not finished yet
+    std::vector<Response> results_;         // Per stage: output produced for the join stage
+    std::function<void()> on_complete_;     // Run by the thread finishing the last stage
 
 public:
-    explicit PipelineTask(MSTree data, int fd);
+    PipelineTask(std::shared_ptr<const MSTree> data, std::shared_ptr<Response> output, unsigned metrics = METRIC_ALL);
 
-    MSTree &getData();
-    void setData(MSTree data);
+    const MSTree &getData() const;
+    void setData(std::shared_ptr<const MSTree> data);
 
-    int getFD()
+    // Only the join stage writes it, the requester gets it back once the task is complete
+    Response &getOutput()
     {
-        return fd_;
+        return *output_;
+    }
+    // Called once every stage is done, on the thread of the last stage, instead of having
+    // someone block in waitForCompletion(). Must be set before the task enters the pipeline.
+    void setOnComplete(std::function<void()> on_complete)
+    {
+        on_complete_ = std::move(on_complete);
+    }
+    // Whether the stage computing the given metric has anything to do for this task
+    bool wants(unsigned metric) const
+    {
+        return (metrics_ & metric) != 0;
     }
     // Wait for the task to be processed in all stages
     void waitForCompletion();
@@ -42,22 +61,76 @@ public:
     {
         remaining_stages_ = remaining_stages;
     }
+
+    // Prepare the per stage bookkeeping before the task enters the pipeline
+    void setDependencies(const std::vector<int> &dependency_counts);
+
+    // Called when one dependency of the given stage is done, returns true once all of them are
+    bool dependencyCompleted(int stage);
+
+    // Each stage writes only its own slot, the join stage reads them after all writers are done
+    Response &getResult(int stage)
+    {
+        return results_[stage];
+    }
+    const std::vector<Response> &getResults() const
+    {
+        return results_;
+    }
 };
 
-// Thread-safe task queue
+// A task with its latencyNow() at enqueue
+using QueuedTask = std::pair<std::shared_ptr<PipelineTask>, uint64_t>;
+
+// Input of a stage: one bounded SPSC ring per upstream stage, plus a shared one for the callers
+// of Pipeline::execute. Both sides spin briefly and then park, the consumers while every ring is
+// empty and a producer while its ring is full, so a slow stage pushes back up to Pipeline::execute.
+// When a side has several threads (replicated stages), they take turns on the ring under a mutex.
 class TaskQueue
 {
 private:
-    std::queue<std::shared_ptr<PipelineTask>> queue_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    struct Input
+    {
+        explicit Input(size_t capacity) : ring(capacity) {}
+        SpscRing<QueuedTask> ring;
+        std::mutex producer_mutex; // Only taken when shared
+        bool shared = false;       // More than one thread produces into this ring
+    };
+    std::vector<std::unique_ptr<Input>> inputs_; // Input 0 is the one for Pipeline::execute
+    size_t next_input_;                          // Consumer side round robin
+    std::mutex consumer_mutex_;                  // Only taken when there is more than one consumer
+    int consumers_;
+    std::mutex park_mutex_;                      // Protects parking only
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::atomic<int> consumers_parked_{0};
+    std::atomic<int> producers_parked_{0};
+    std::atomic<bool> closed_{false};
+
+    bool allEmpty() const;
+    void push(Input &input, std::shared_ptr<PipelineTask> task);
 
 public:
-    // Enqueue a task
+    TaskQueue();
+
+    // Add a ring for one upstream stage and return its input number. Only before the consumers start.
+    int addProducer();
+
+    // Number of threads producing into the given input, or consuming. Only before they start.
+    void setProducerCount(int input, int producers);
+    void setConsumerCount(int consumers);
+
+    // Enqueue from the upstream stage owning the given input (waits while its ring is full)
+    void enqueue(int input, std::shared_ptr<PipelineTask> task);
+
+    // Enqueue from any thread through the shared input (waits while it is full)
     void enqueue(std::shared_ptr<PipelineTask> task);
 
-    // Dequeue a task (waits if the queue is empty)
+    // Dequeue a task (waits while every ring is empty). Returns nullptr once closed and drained.
     std::shared_ptr<PipelineTask> dequeue();
+
+    // Let dequeue return nullptr once the tasks already queued are taken
+    void close();
 };
 
 // Active Object class representing each stage of the pipeline
@@ -66,9 +139,11 @@ class ActiveObject
 
 private:
     TaskQueue queue_;
-    std::thread thread_;
-    bool done_;
-    ActiveObject *next_stage_; // Pointer to the next stage in the pipeline
+    std::vector<std::thread> threads_; // Replicas, all taking tasks from queue_
+    int replicas_;
+    std::vector<std::pair<ActiveObject *, int>> next_stages_; // Stages that depend on this one, with our input there
+    int index_;                               // Position of the stage in its pipeline
+    int dependency_count_;                    // Number of stages this one depends on
 protected:
     // Process function to be implemented by subclasses
     virtual void processTask(std::shared_ptr<PipelineTask> task) = 0;
@@ -77,21 +152,58 @@ public:
     explicit ActiveObject(ActiveObject *next_stage = nullptr);
     virtual ~ActiveObject();
 
-    // Start the active object thread
+    // Start the active object threads
     void start();
 
-    // Stop the active object thread (optional for cleanup)
+    // Stop the active object threads (optional for cleanup)
     void stop();
 
-    // Enqueue a task to this stage
+    // Number of threads running this stage, 0 means std::thread::hardware_concurrency().
+    // Only before start(). Tasks then finish out of order, processTask must not rely on it. Replies
+    // stay coherent: a task only writes its own reply, and a connection's next command waits for it.
+    void setReplicas(int replicas);
+    int getReplicas() const
+    {
+        return replicas_;
+    }
+
+    // Enqueue a task to this stage, from any thread
     void enqueueTask(std::shared_ptr<PipelineTask> task);
 
+    // Enqueue a task to this stage from the upstream stage owning the given input
+    void enqueueTask(int input, std::shared_ptr<PipelineTask> task);
+
+    // Links are only made before the stages start, each one gets its own ring in next_stage
     void setNextStage(ActiveObject *next_stage)
     {
-        next_stage_ = next_stage;
+        next_stages_.clear();
+        addNextStage(next_stage);
     }
 
-    // Run method executed by the thread
+    void addNextStage(ActiveObject *next_stage)
+    {
+        next_stages_.push_back({next_stage, next_stage->queue_.addProducer()});
+    }
+
+    void setIndex(int index)
+    {
+        index_ = index;
+    }
+    int getIndex() const
+    {
+        return index_;
+    }
+
+    void setDependencyCount(int dependency_count)
+    {
+        dependency_count_ = dependency_count;
+    }
+    int getDependencyCount() const
+    {
+        return dependency_count_;
+    }
+
+    // Run method executed by every replica
     void run();
 };
 class PLTotalWeight : public ActiveObject
@@ -129,19 +241,39 @@ protected:
     void processTask(std::shared_ptr<PipelineTask> task) override;
 };
 
+// Join stage: appends the results gathered from all the other stages to the reply, in stage order
+class PLJoin : public ActiveObject
+{
+public:
+    using ActiveObject::ActiveObject;
+
+protected:
+    void processTask(std::shared_ptr<PipelineTask> task) override;
+};
+
 // Pipeline class holding the stages
 class Pipeline
 {
+public:
+    enum Mode
+    {
+        SERIAL,  // Every stage depends on the previous one
+        FAN_OUT  // The metric stages all start at once and a join stage waits for them
+    };
+
 private:
-    Pipeline();                                     // Private constructor for singleton pattern
+    explicit Pipeline(Mode mode);                   // Private constructor for singleton pattern
     Pipeline(const Pipeline &) = delete;            // Prevent copying
     Pipeline &operator=(const Pipeline &) = delete; // Prevent assignment
 
     std::vector<ActiveObject *> stages_; // Hold the stages
 public:
-    // Add a stage to the pipeline
+    // Add a stage after the last one added
     void addStage(ActiveObject *stage);
 
+    // Add a stage that starts once all the given stages are done (no dependencies: starts at once)
+    void addStage(ActiveObject *stage, const std::vector<ActiveObject *> &depends_on);
+
     // Execute a task through the pipeline (independently in all stages)
     void execute(std::shared_ptr<PipelineTask> task);
 
@@ -154,8 +286,8 @@ public:
     // Get the number of stages in the pipeline
     int getStageCount() const;
 
-    // Singleton pattern: Get the pipeline instance (initialized with stages)
-    static Pipeline &getPipeline();
+    // Singleton pattern: Get the pipeline instance of the given mode (initialized with stages)
+    static Pipeline &getPipeline(Mode mode = FAN_OUT);
 };
 
 #endif // PIPELINE_HPP
@@ -12,12 +12,20 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
 #include <poll.h>
 #include <atomic>
+#include <memory>
+#include <unordered_map>
 #include "pollserver.hpp"
 #include "listner.hpp"
 #include "execute_commands.hpp"
 #include "tcp_client_thread_pool.hpp"
+#include "latency_stats.hpp"
+
+#define MAX_EVENTS 64
 // Retrieve IP address from sockaddr, for either IPv4 or IPv6
 void *get_in_addr(struct sockaddr *sa)
 {
@@ -28,113 +36,168 @@ void *get_in_addr(struct sockaddr *sa)
     return &(((struct sockaddr_in6 *)sa)->sin6_addr);
 }
 
-// Add a new file descriptor to the pollfd array
-void add_to_pfds(struct pollfd *pfds[], int newfd, int *fd_count, int *fd_size)
+// Register a file descriptor with epoll
+void add_to_epoll(int epoll_fd, int fd, uint32_t events)
 {
-    // If we don't have room, add more space in the pfds array
-    if (*fd_count == *fd_size)
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
     {
-        *fd_size *= 2; // Double it
-
-        *pfds = (struct pollfd *)realloc(*pfds, sizeof(**pfds) * (*fd_size));
+        perror("epoll_ctl");
     }
-    (*pfds)[*fd_count].fd = newfd;
-    (*pfds)[*fd_count].events = POLLIN; // Check ready-to-read
-    (*pfds)[*fd_count].revents = 0;
-    (*fd_count)++;
-    printf("add_to_pfds:  %d\n", newfd);
+    printf("add_to_epoll:  %d\n", fd);
 }
-// Add a context to the context list, managing size and duplicates
-void add_to_contexts(struct Context *ctxs[], struct Context *ctx, int *context_count, int *context_size)
+
+void Reactor::rearm(int fd)
 {
-    bool inList = false;
-    // check if fd is in the list
-    for (int i = 0; i < *context_count; i++)
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+    ev.data.fd = fd;
+    // MOD re-evaluates readiness, so data that arrived while the worker ran is not lost
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1)
     {
-        if ((*ctxs)[i].fd == ctx->fd)
-        {
-            inList = true;
-            (*ctxs)[i].context = ctx->context;
-            break;
-        }
+        perror("epoll_ctl");
     }
-    // If we don't have room, add more space in the pfds array
-    if (!inList)
+}
+
+void Reactor::release(int fd)
+{
     {
-        if (*context_count == *context_size)
-        {
-            *context_size *= 2; // Double it
+        std::lock_guard<std::mutex> lock(closed_mutex);
+        closed_fds.push_back(fd);
+    }
+    uint64_t one = 1;
+    write(wake_fd, &one, sizeof(one));
+}
 
-            *ctxs = (struct Context *)realloc(*ctxs, sizeof(**ctxs) * (*context_size));
-        }
-        (*ctxs)[*context_count] = *ctx;
-        (*context_count)++;
+bool Reactor::enter()
+{
+    std::lock_guard<std::mutex> lock(work_mutex);
+    if (stopping)
+    {
+        return false;
     }
+    ++in_flight;
+    return true;
+}
+
+void Reactor::leave()
+{
+    std::lock_guard<std::mutex> lock(work_mutex);
+    --in_flight;
+    work_done.notify_all(); // Under the lock: the reactor may be gone as soon as it is released
 }
-// Retrieve context for a specific file descriptor
-void *get_context(Context ctxs[], int fd, int *context_count)
+
+void Reactor::shutdown()
+{
+    std::unique_lock<std::mutex> lock(work_mutex);
+    stopping = true;
+    work_done.wait(lock, [this]
+                   { return in_flight == 0; });
+}
+
+void Reactor::resume(int fd, std::string reply)
 {
-    void *context = NULL;
-    for (int i = 0; i < *context_count; i++)
+    std::lock_guard<std::mutex> lock(work_mutex);
+    if (!stopping)
     {
-        if (ctxs[i].fd == fd)
         {
-            context = ctxs[i].context;
-            break;
+            std::lock_guard<std::mutex> closed_lock(closed_mutex);
+            resumed_fds.emplace_back(fd, std::move(reply));
         }
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
     }
-    return context;
+    --in_flight;
+    work_done.notify_all();
 }
 
-// Remove a file descriptor from the pollfd array
-void del_from_pfds(struct pollfd pfds[], int i, int *fd_count)
+void Reactor::drain(Context &ctx)
 {
-    printf("going to remove %d\n", pfds[i].fd);
-    // Copy the one from the end over this one
-    pfds[i] = pfds[*fd_count - 1];
-    (*fd_count)--;
+    ctx.draining = true;
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLET | EPOLLONESHOT;
+    ev.data.fd = ctx.fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, ctx.fd, &ev) == -1)
+    {
+        perror("epoll_ctl");
+    }
 }
-// del_from_contexts(contexts, pfds[i].fd, &context_count);
-void del_from_contexts(Context ctxs[], int fd, int *context_count)
+
+bool sendOutput(Context &ctx, bool wait)
 {
-    bool inList = false;
-    int i = 0;
-    // check if fd is in the list
-    for (i = 0; i < *context_count; i++)
+    if (ctx.output.empty())
     {
-        if ((ctxs)[i].fd == fd)
+        return true;
+    }
+    LatencyTimer timer(PHASE_WRITE);
+    size_t sent = 0;
+    while (sent < ctx.output.size())
+    {
+        ssize_t n = send(ctx.fd, ctx.output.data() + sent, ctx.output.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n >= 0)
+        {
+            sent += n;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            inList = true;
+            if (!wait)
+                break;
+            struct pollfd writable = {ctx.fd, POLLOUT, 0};
+            poll(&writable, 1, -1);
+        }
+        else if (errno != EINTR)
+        {
+            perror("send");
+            ctx.output.clear(); // Its reader sees the hang-up and releases the client
             break;
         }
     }
-    if (inList)
+    bytesWritten().fetch_add(sent, std::memory_order_relaxed);
+    ctx.output.erase(0, sent);
+    return ctx.output.empty();
+}
+
+// Send what is left of a client's reply. Once it is all out, go on with the client: run the
+// commands buffered behind its asynchronous request, or wait for new ones.
+static void continueClient(Reactor &reactor, TcpClientThreadPool &pool, const std::shared_ptr<Context> &ctx)
+{
+    if (!sendOutput(*ctx, false))
+    {
+        reactor.drain(*ctx);
+        return;
+    }
+    ctx->draining = false;
+    if (ctx->resuming)
+    {
+        pool.enqueue(ctx);
+    }
+    else
     {
-        ctxs[i] = ctxs[*context_count - 1];
-        (*context_count)--;
+        reactor.rearm(ctx->fd);
     }
 }
+
 // Main function to handle polling of clients and managing events
 void poll_clients(const char *port, std::atomic<bool> &exit_flag)
 {
     int listener;
-    int pipefds[2];
     int newfd;
     struct sockaddr_storage remoteaddr;
     socklen_t addrlen;
     char remoteIP[INET6_ADDRSTRLEN];
+    Reactor reactor;
+    std::unordered_map<int, std::shared_ptr<Context>> contexts; // Only touched by this thread
 
-    if (pipe(pipefds) == -1)
+    reactor.epoll_fd = epoll_create1(0);
+    reactor.wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (reactor.epoll_fd == -1 || reactor.wake_fd == -1)
     {
-        fprintf(stderr, "error creating pipe\n");
+        fprintf(stderr, "error creating epoll/eventfd\n");
         exit(EXIT_FAILURE);
     }
 
-    int fd_count = 0;
-    int fd_size = 7;
-    int context_count = 0;
-    int context_size = 5;
-
     listener = createListner(port);
     if (listener == -1)
     {
@@ -142,93 +205,116 @@ void poll_clients(const char *port, std::atomic<bool> &exit_flag)
         exit(EXIT_FAILURE);
     }
 
-    struct pollfd *pfds = (struct pollfd *)malloc(sizeof *pfds * fd_size);
-    struct Context *contexts = (struct Context *)malloc(sizeof *contexts * context_size);
-
-    pfds[0].fd = listener;
-    pfds[0].events = POLLIN;
-    pfds[1].fd = pipefds[0];
-    pfds[1].events = POLLIN;
-    fd_count = 2;
+    add_to_epoll(reactor.epoll_fd, listener, EPOLLIN);
+    add_to_epoll(reactor.epoll_fd, reactor.wake_fd, EPOLLIN);
 
     TcpClientThreadPool tcpClientThreadPool(4);
+    struct epoll_event events[MAX_EVENTS];
 
     for (;;)
     {
-        int poll_count = poll(pfds, fd_count, 500); // Timeout to allow flag checks
+        int event_count = epoll_wait(reactor.epoll_fd, events, MAX_EVENTS, 500); // Timeout to allow flag checks
 
-        // Check the exit flag after poll returns
+        // Check the exit flag after epoll_wait returns
         if (exit_flag.load())
         {
             break;
         }
 
-        if (poll_count == -1)
+        if (event_count == -1)
         {
-            perror("poll");
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
             exit(1);
         }
 
-        for (int i = 0; i < fd_count; i++)
+        for (int i = 0; i < event_count; i++)
         {
-            if (pfds[i].revents & POLLIN)
+            int fd = events[i].data.fd;
+            if (fd == listener)
             {
-                if (pfds[i].fd == listener)
-                {
-                    addrlen = sizeof remoteaddr;
-                    newfd = accept(listener, (struct sockaddr *)&remoteaddr, &addrlen);
+                addrlen = sizeof remoteaddr;
+                newfd = accept(listener, (struct sockaddr *)&remoteaddr, &addrlen);
 
-                    if (newfd == -1)
-                    {
-                        perror("accept");
-                    }
-                    else
-                    {
-                        add_to_pfds(&pfds, newfd, &fd_count, &fd_size);
-
-                        printf("pollserver: new connection from %s on socket %d\n",
-                               inet_ntop(remoteaddr.ss_family,
-                                         get_in_addr((struct sockaddr *)&remoteaddr),
-                                         remoteIP, INET6_ADDRSTRLEN),
-                               newfd);
-                        printCommandsToFd(newfd);
-                    }
+                if (newfd == -1)
+                {
+                    perror("accept");
+                }
+                else
+                {
+                    contexts[newfd] = std::make_shared<Context>(newfd, &reactor, nullptr);
+                    printf("pollserver: new connection from %s on socket %d\n",
+                           inet_ntop(remoteaddr.ss_family,
+                                     get_in_addr((struct sockaddr *)&remoteaddr),
+                                     remoteIP, INET6_ADDRSTRLEN),
+                           newfd);
+                    printCommandsToFd(newfd);
+                    add_to_epoll(reactor.epoll_fd, newfd, EPOLLIN | EPOLLET | EPOLLONESHOT);
                 }
-                else if (pfds[i].fd == pipefds[0])
+            }
+            else if (fd == reactor.wake_fd)
+            {
+                uint64_t count;
+                read(reactor.wake_fd, &count, sizeof(count));
+                std::vector<int> closed;
+                std::vector<std::pair<int, std::string>> resumed;
                 {
-                    printf("completed client operation.going to read from pipe\n");
-                    struct Context ctx(-1, -1, NULL);
-                    read(pfds[i].fd, &ctx, sizeof(ctx));
-                    if (ctx.context == INVALID_POINTER)
-                    {
-                        del_from_contexts(contexts, ctx.fd, &context_count);
-                    }
-                    else
+                    std::lock_guard<std::mutex> lock(reactor.closed_mutex);
+                    closed.swap(reactor.closed_fds);
+                    resumed.swap(reactor.resumed_fds);
+                }
+                for (auto &resumed_reply : resumed)
+                {
+                    auto it = contexts.find(resumed_reply.first);
+                    if (it != contexts.end())
                     {
-                        add_to_contexts(&contexts, &ctx, &context_count, &context_size);
-                        add_to_pfds(&pfds, ctx.fd, &fd_count, &fd_size);
+                        it->second->output += resumed_reply.second;
+                        it->second->resuming = true;
+                        continueClient(reactor, tcpClientThreadPool, it->second);
                     }
                 }
-                else
+                for (int closed_fd : closed)
                 {
-                    printf("ready to read from %d, going to post to thread pool!!!\n", pfds[i].fd);
-                    tcpClientThreadPool.enqueue(std::make_shared<Context>(pfds[i].fd, pipefds[1], get_context(contexts, pfds[i].fd, &context_count)));
-                    del_from_pfds(pfds, i, &fd_count);
+                    printf("going to remove %d\n", closed_fd);
+                    epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, closed_fd, NULL);
+                    contexts.erase(closed_fd);
+                    close(closed_fd); // Closed here so the fd number cannot be reused before its context is gone
+                }
+            }
+            else
+            {
+                // One-shot: the socket stays disarmed until the worker re-arms it
+                auto it = contexts.find(fd);
+                if (it != contexts.end() && it->second->draining)
+                {
+                    continueClient(reactor, tcpClientThreadPool, it->second); // Writable again
+                }
+                else if (it != contexts.end())
+                {
+                    printf("ready to read from %d, going to post to thread pool!!!\n", fd);
+                    tcpClientThreadPool.enqueue(it->second);
                 }
             }
         }
     }
 
-    // Clean up on exit
-    for (int i = 2; i < fd_count; i++)
+    // Clean up on exit. Shutting the sockets down ends the reads and writes workers are blocked
+    // in, then no worker or asynchronous request touches the reactor or a client any more.
+    for (auto &entry : contexts)
+    {
+        shutdown(entry.first, SHUT_RDWR);
+    }
+    reactor.shutdown();
+    for (auto &entry : contexts)
     {
-        tcpClientThreadPool.enqueue(std::make_shared<Context>(-1, -1, get_context(contexts, pfds[i].fd, &context_count)));
-        close(pfds[i].fd);
+        tcpClientThreadPool.enqueue(std::make_shared<Context>(-1, &reactor, entry.second->context));
+        close(entry.first);
     }
     close(listener);
-    close(pipefds[0]);
-    close(pipefds[1]);
-    free(pfds);
-    free(contexts);
+    close(reactor.wake_fd);
+    close(reactor.epoll_fd);
     printf("poll_clients exiting...\n");
 }
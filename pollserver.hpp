@@ -1,17 +1,64 @@
 #ifndef __POLLSERVER_H__
 #define __POLLSERVER_H__
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Context;
+
+// State shared between the reactor thread and the workers serving its clients
+struct Reactor
+{
+    int epoll_fd;                // epoll instance watching the listener and the clients
+    int wake_fd;                 // eventfd used by workers to wake the reactor
+    std::mutex closed_mutex;     // Protects closed_fds and resumed_fds
+    std::vector<int> closed_fds; // Client sockets that hung up, closed by the reactor thread
+    std::vector<std::pair<int, std::string>> resumed_fds; // Clients whose asynchronous request completed, with its reply
+    std::mutex work_mutex;       // Protects in_flight and stopping
+    std::condition_variable work_done;
+    int in_flight = 0;           // Workers serving a client plus asynchronous requests not resumed yet
+    bool stopping = false;       // Set once the reactor shuts down, no new work starts after it
+    // Called by a worker before it serves a client. Returns false once the reactor shuts down. The
+    // hold ends with leave(), or with resume() if a request went on asynchronously.
+    bool enter();
+    void leave();
+    // Stop handing out work and wait until every worker and asynchronous request has left
+    void shutdown();
+    // Re-arm a one-shot client socket once a worker is done with its command
+    void rearm(int fd);
+    // Hand a hung-up client back to the reactor so it can drop the context and close the socket
+    void release(int fd);
+    // A client's asynchronous request is done: the reactor writes its reply, then has a worker go
+    // on with the buffered commands. Safe to call from any thread, it never writes to the client.
+    // Ends the request's hold on the reactor, and does nothing else once it shuts down.
+    void resume(int fd, std::string reply);
+    // Wait for the client socket to become writable so the reactor can send the rest of its output
+    void drain(Context &ctx);
+};
+
 // Context struct representing client specific dada
 struct Context
 {
     int fd; // File descriptor for the client connection
-    int pipe_write_fd; // Pipe descriptor for communication with thread pool
+    Reactor *reactor; // Reactor the client belongs to
     void *context;  // Custom context pointer for additional client data
-    Context(int _fd, int _pipe_write_fd, void *_context) : fd(_fd), pipe_write_fd(_pipe_write_fd), context(_context)
+    std::string input; // Bytes received but not yet run as a command, only touched by the worker holding the fd
+    bool resuming = false; // Set by the reactor: continue with input instead of reading the socket
+    std::string output;    // Reply bytes the socket did not take yet, sent before any further command runs
+    bool draining = false; // The reactor is waiting for the socket to take output
+    Context(int _fd, Reactor *_reactor, void *_context) : fd(_fd), reactor(_reactor), context(_context)
     {
     }
 };
+// Send as much of ctx.output as the socket takes without blocking, or all of it if wait is set.
+// Returns true once nothing is left. A client that is gone has its output dropped.
+bool sendOutput(Context &ctx, bool wait);
+
 // Main function to start the poll server and handle clients on the specified port
 void poll_clients(const char *port, std::atomic<bool>& exit_flag);
 
-#endif // __POLLSERVER_H__
\ No newline at end of file
+#endif // __POLLSERVER_H__
@@ -0,0 +1,150 @@
+#include "response.hpp"
+#include "latency_stats.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+// Longest text to_chars can produce for any of the number types below
+#define NUMBER_MAX_CHARS 32
+
+Response::Response(int fd) : fd_(fd) {}
+
+Response::Response(Sink sink) : fd_(-1), sink_(move(sink)) {}
+
+Response::~Response()
+{
+    flush();
+}
+
+Response::Response(Response &&other) noexcept : buf_(move(other.buf_)), fd_(other.fd_), sink_(move(other.sink_))
+{
+    other.buf_.clear();
+}
+
+Response &Response::operator=(Response &&other) noexcept
+{
+    if (this != &other)
+    {
+        flush();
+        buf_ = move(other.buf_);
+        fd_ = other.fd_;
+        sink_ = move(other.sink_);
+        other.buf_.clear();
+    }
+    return *this;
+}
+
+void Response::append(const char *data, size_t size)
+{
+    buf_.insert(buf_.end(), data, data + size);
+    flushIfFull();
+}
+
+Response &Response::operator<<(const char *text)
+{
+    append(text, strlen(text));
+    return *this;
+}
+
+Response &Response::operator<<(const string &text)
+{
+    append(text.data(), text.size());
+    return *this;
+}
+
+Response &Response::operator<<(char c)
+{
+    buf_.push_back(c);
+    flushIfFull();
+    return *this;
+}
+
+Response &Response::operator<<(const Response &other)
+{
+    append(other.buf_.data(), other.buf_.size());
+    return *this;
+}
+
+// Format into spare room at the end of the buffer and keep only what to_chars produced
+template <typename... Args>
+static void appendNumber(vector<char> &buf, Args... args)
+{
+    size_t used = buf.size();
+    buf.resize(used + NUMBER_MAX_CHARS);
+    to_chars_result result = to_chars(buf.data() + used, buf.data() + buf.size(), args...);
+    buf.resize(result.ptr - buf.data());
+}
+
+Response &Response::operator<<(int value)
+{
+    appendNumber(buf_, value);
+    flushIfFull();
+    return *this;
+}
+
+Response &Response::operator<<(size_t value)
+{
+    appendNumber(buf_, value);
+    flushIfFull();
+    return *this;
+}
+
+Response &Response::operator<<(double value)
+{
+    appendNumber(buf_, value, chars_format::general, 6);
+    flushIfFull();
+    return *this;
+}
+
+void Response::flushIfFull()
+{
+    if (fd_ != -1 && buf_.size() >= RESPONSE_FLUSH_SIZE)
+    {
+        flush();
+    }
+}
+
+void Response::flush(bool wait)
+{
+    if (buf_.empty())
+    {
+        return;
+    }
+    if (sink_)
+    {
+        sink_(buf_.data(), buf_.size(), wait);
+        buf_.clear();
+        return;
+    }
+    if (fd_ == -1)
+    {
+        return;
+    }
+    LatencyTimer timer(PHASE_WRITE);
+    size_t sent = 0;
+    while (sent < buf_.size())
+    {
+        ssize_t n = write(fd_, buf_.data() + sent, buf_.size() - sent);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            perror("write");
+            break;
+        }
+        sent += n;
+    }
+    bytesWritten().fetch_add(sent, memory_order_relaxed);
+    buf_.clear(); // Keeps the capacity for the rest of the response
+}
+
+string Response::release()
+{
+    string text(buf_.begin(), buf_.end());
+    buf_.clear();
+    return text;
+}
@@ -0,0 +1,61 @@
+#ifndef RESPONSE_HPP
+#define RESPONSE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Bytes buffered before a Response writes them out on its own
+#define RESPONSE_FLUSH_SIZE (64 * 1024)
+
+// Text reply to one client request. Numbers are formatted with std::to_chars straight into a
+// growable buffer, which is written with a single write() when the response is flushed or
+// destroyed, or every RESPONSE_FLUSH_SIZE bytes for long replies.
+// A Response without an fd only collects text, to be appended to another Response later.
+// A Response with a sink never flushes on its own: flush() hands the bytes to the sink, so the
+// connection decides when and from which thread they are written to the client.
+class Response
+{
+public:
+    // Receives the bytes of a flush, on the thread calling flush(). With wait set it returns only
+    // once they are written.
+    typedef std::function<void(const char *data, size_t size, bool wait)> Sink;
+
+    explicit Response(int fd = -1);
+    explicit Response(Sink sink);
+    ~Response();
+    Response(Response &&other) noexcept;
+    Response &operator=(Response &&other) noexcept;
+    Response(const Response &) = delete;
+    Response &operator=(const Response &) = delete;
+
+    Response &operator<<(const char *text);
+    Response &operator<<(const std::string &text);
+    Response &operator<<(char c);
+    Response &operator<<(int value);
+    Response &operator<<(size_t value);
+    // Same digits as an ostream with the default precision (printf "%g")
+    Response &operator<<(double value);
+    Response &operator<<(const Response &other);
+    void append(const char *data, size_t size);
+
+    // Write out everything buffered so far. Set wait before blocking on the client, so that a
+    // sink does not leave the bytes for later.
+    void flush(bool wait = false);
+    // Take everything buffered so far, for a reply completed on a thread that must not write it
+    std::string release();
+    size_t size() const
+    {
+        return buf_.size();
+    }
+
+private:
+    std::vector<char> buf_;
+    int fd_;
+    Sink sink_;
+
+    void flushIfFull();
+};
+
+#endif // RESPONSE_HPP
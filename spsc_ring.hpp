@@ -0,0 +1,87 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+// The capacity is rounded up to a power of two. Neither side ever blocks: tryPush fails while
+// the ring is full and tryPop while it is empty, how to wait is up to the caller.
+template <typename T>
+class SpscRing
+{
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to pop, only the consumer writes it
+    size_t cachedTail_ = 0;                   // Consumer's last view of tail_, saves reading it on every pop
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to push, only the producer writes it
+    size_t cachedHead_ = 0;                   // Producer's last view of head_
+
+public:
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+    // Producer only
+    bool tryPush(const T &value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_)
+            {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. The slot is moved from, so it does not keep the value alive.
+    bool tryPop(T &value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+            {
+                return false;
+            }
+        }
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact from either side of the ring, a snapshot for anyone else
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    bool full() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) > mask_;
+    }
+};
+
+#endif // SPSC_RING_HPP
@@ -39,6 +39,31 @@ void TcpClientThreadPool::enqueue(std::shared_ptr<Context> ctx)
     condition.notify_one(); // Notify one waiting thread to process the new task
 }
 
+// Execute every complete command received so far and update context. The socket is re-armed
+// only once they all ran and their replies are sent: while a request completes asynchronously or
+// the client does not read its replies, the client stays paused.
+// Returns false if a request went on asynchronously, holding the reactor until it resumes.
+static bool runCommands(std::shared_ptr<Context> ctx)
+{
+    // Replies are sent without blocking, the reactor writes whatever the socket does not take
+    auto sink = [ctx](const char *data, size_t size, bool wait)
+    {
+        ctx->output.append(data, size);
+        sendOutput(*ctx, wait);
+    };
+    bool finished = executeCommandsToFd(ctx->fd, ctx->input, &ctx->context, sink, [ctx](std::string reply)
+                                        { ctx->reactor->resume(ctx->fd, std::move(reply)); });
+    if (finished && ctx->output.empty())
+    {
+        ctx->reactor->rearm(ctx->fd); // Ready for the next command
+    }
+    else if (finished)
+    {
+        ctx->reactor->drain(*ctx);
+    }
+    return finished;
+}
+
 // Worker thread function - processes tasks from the queue
 void TcpClientThreadPool::worker()
 {
@@ -63,11 +88,22 @@ void TcpClientThreadPool::worker()
             freeContext(ctx->context);
             ctx->context = INVALID_POINTER;
         }
+        else if (!ctx->reactor->enter())
+        {
+            printf("worker: reactor shutting down, dropping %d\n", ctx->fd);
+        }
+        else if (ctx->resuming)
+        {
+            // An asynchronous request finished, go on with the commands buffered behind it
+            ctx->resuming = false;
+            if (runCommands(ctx))
+                ctx->reactor->leave();
+        }
         else
         {
-            char buf[256]; // Buffer for client data
+            char buf[MAX_COMMAND_SIZE]; // One large read per readiness event
             printf("going to call recv!!!\n");
-            int nbytes = recv(ctx->fd, buf, sizeof(buf) - 1, 0);
+            int nbytes = recv(ctx->fd, buf, sizeof(buf), 0);
             printf("returned from recv!!!\n");
 
             if (nbytes <= 0)
@@ -82,23 +118,17 @@ void TcpClientThreadPool::worker()
                 {
                     perror("recv");
                 }
-                close(ctx->fd); // Bye!
                 freeContext(ctx->context);
                 ctx->context = INVALID_POINTER;
-                write(ctx->pipe_write_fd, ctx.get(), sizeof(Context));
-                // write to the pipe with context==-1
+                ctx->reactor->release(ctx->fd); // The reactor closes the socket. Bye!
+                ctx->reactor->leave();
             }
             else
             {
-                while (nbytes > 0 && isspace((unsigned char)buf[nbytes - 1]))
-                {
-                    --nbytes;
-                }
-                buf[nbytes] = '\0';
-                printf("buf: %s\n", buf);
-                // Execute command received from client and update context
-                executeCommandToFd(ctx->fd, buf, &ctx->context);
-                write(ctx->pipe_write_fd, ctx.get(), sizeof(Context)); // write to pipe with context returned from executeCommandToFd
+                printf("received %d bytes\n", nbytes);
+                ctx->input.append(buf, nbytes);
+                if (runCommands(ctx))
+                    ctx->reactor->leave();
             }
         }
     }
@@ -32,4 +32,39 @@ bool UnionFind::unite(int x, int y)
 	rank[x] += (rank[x] == rank[y]);
 	--cc;
 	return true;
-}
\ No newline at end of file
+}
+
+ConcurrentUnionFind::ConcurrentUnionFind(int _n) : parent(_n), n(_n), cc(_n)
+{
+	for (int i = 0; i < n; ++i) parent[i].store(i, memory_order_relaxed);
+}
+
+int ConcurrentUnionFind::find_parent(int node)
+{
+	while (true)
+	{
+		int p = parent[node].load(memory_order_acquire);
+		if (p == node) return node;
+		int gp = parent[p].load(memory_order_acquire);
+		if (gp != p) parent[node].compare_exchange_weak(p, gp, memory_order_acq_rel);
+		node = gp;
+	}
+}
+
+bool ConcurrentUnionFind::unite(int x, int y)
+{
+	while (true)
+	{
+		x = find_parent(x);
+		y = find_parent(y);
+		if (x == y) return false;
+		if (x > y) swap(x, y);
+		int expected = x;
+		// Fails if x stopped being a root in the meantime, then retry from the new roots
+		if (parent[x].compare_exchange_strong(expected, y, memory_order_acq_rel))
+		{
+			--cc;
+			return true;
+		}
+	}
+}
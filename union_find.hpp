@@ -2,6 +2,7 @@
 #define UNION_FIND_H
 
 #include <vector>
+#include <atomic>
 
 // Implementation of Union Find (Disjoint Set Union)
 // Code includes Path Compression and Union by Rank for speeding it up
@@ -15,4 +16,17 @@ struct UnionFind
 	int n, cc;
 };
 
+// Concurrent variant of UnionFind for use from several threads at once.
+// Parents are atomics updated with compare-and-swap, find_parent halves paths as it goes and
+// unite links the smaller root index under the larger one, so concurrent links never form a cycle.
+struct ConcurrentUnionFind
+{
+	ConcurrentUnionFind(int _n);
+	int find_parent(int node);
+	bool unite(int x, int y);
+	std::vector<std::atomic<int>> parent;
+	int n;
+	std::atomic<int> cc;
+};
+
 #endif
\ No newline at end of file